@@ -0,0 +1,446 @@
+/*
+Microbenchmarks of the interpreter.
+
+	$ g++ -O2 bench.cpp -o bench -lpthread
+	$ ./bench [-t seconds] [filter]
+
+Only the benchmarks whose name contains filter are run. Each benchmark is repeated with a growing number of operations
+until one run lasts at least the given time (0.5s by default), and that run is reported. The results are printed as
+JSON, one benchmark per line, in a fixed order and with a fixed number of decimals, so that the results of two builds
+can be compared line by line. allocs_per_op and bytes_per_op count the calls to operator new and the bytes requested
+by them, plus the objects which the isolate serves from its free list without calling operator new.
+*/
+#define NEO_LIBRARY
+#include "neo.cpp"
+
+#include <time.h>
+#include <new>
+
+//allocations made while running the benchmarks. the benchmarks run on a single thread.
+static unsigned long long allocations = 0;
+static unsigned long long allocated_bytes = 0;
+
+//calls to operator new, and the objects served from the free list of the isolate of the benchmarks.
+static unsigned long long allocations_so_far()
+{
+	return allocations + isolate::current()->reused_blocks;
+}
+
+static unsigned long long allocated_bytes_so_far()
+{
+	return allocated_bytes + isolate::current()->reused_bytes;
+}
+
+//the replaced operator new and every form of operator delete go through this pair.
+static void* counted_allocate(size_t n)
+{
+	++allocations;
+	allocated_bytes += n;
+	void* p = malloc(n ? n : 1);
+	if(p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+static void counted_release(void* p)
+{
+	free(p);
+}
+
+void* operator new(size_t n) { return counted_allocate(n); }
+void* operator new[](size_t n) { return counted_allocate(n); }
+void operator delete(void* p) throw() { counted_release(p); }
+void operator delete[](void* p) throw() { counted_release(p); }
+#if __cplusplus >= 201402L
+void operator delete(void* p, size_t) noexcept { counted_release(p); }
+void operator delete[](void* p, size_t) noexcept { counted_release(p); }
+#endif
+
+//defeats the optimizer for results of benchmarks which are otherwise unused.
+static volatile size_t sink;
+
+static double now()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+class benchmark
+{
+	public:
+		benchmark(const char* n) : name(n) {}
+		virtual ~benchmark() {}
+
+		//setup and teardown are not part of the measurement.
+		virtual void setup() {}
+		virtual void teardown() {}
+
+		//performs n operations.
+		virtual void run(size_t n) = 0;
+
+		const char* name;
+};
+
+//reads tokens from source over and over again. one operation reads one token.
+class tokenize_benchmark : public benchmark
+{
+	public:
+		tokenize_benchmark(const char* n, const char* s) : benchmark(n), source(s) {}
+
+		void run(size_t n)
+		{
+			const char* p = source;
+			token_t t;
+			for(size_t i = 0; i < n; )
+			{
+				p = get_next_token(p, &t);
+				if(p == NULL)
+				{
+					p = source;
+					continue;
+				}
+				if(t.type == OP_OBJECT)
+					object::object_reap(t.objectp);
+				++i;
+			}
+		}
+	private:
+		const char* source;
+};
+
+//converts an expression to postfix. one operation converts the whole expression.
+class infix_to_postfix_benchmark : public benchmark
+{
+	public:
+		infix_to_postfix_benchmark(const char* n, const char* e) : benchmark(n), expression(e) {}
+
+		void setup()
+		{
+			string_reader r(expression);
+			tokenize_infix(r, tokens);
+		}
+
+		void teardown() { release_postfix(tokens); }
+
+		void run(size_t n)
+		{
+			for(size_t i = 0; i < n; ++i)
+			{
+				vector< token_t > v;
+				infix_to_postfix(tokens, v);
+				sink = v.size();
+			}
+		}
+	private:
+		const char* expression;
+		vector< token_t > tokens;
+};
+
+//evaluates a compiled expression, using the variables defined by a setup script. one operation evaluates the
+//expression.
+class evaluate_benchmark : public benchmark
+{
+	public:
+		evaluate_benchmark(const char* n, const char* s, const char* e) : benchmark(n), script(s), expression(e) {}
+
+		void setup()
+		{
+			//the script has one statement per line.
+			const char* p = script;
+			while(*p != '\0')
+			{
+				const char* e = strchr(p, '\n');
+				if(e == NULL)
+					e = p + strlen(p);
+				string statement(p, e - p);
+				p = (*e == '\n') ? e + 1 : e;
+
+				vector< token_t > v;
+				token_t t = compile_infix(statement.c_str(), v);
+				if(t.type != OP_INVALID)
+					t = evaluate_postfix(v, s, st);
+				if(t.type == OP_OBJECT && t.objectp && t.objectp->get_refcount() == 0)
+					object::object_reap(t.objectp);
+			}
+			compile_infix(expression, postfix);
+		}
+
+		void teardown()
+		{
+			release_postfix(postfix);
+			st.clear();
+		}
+
+		void run(size_t n)
+		{
+			for(size_t i = 0; i < n; ++i)
+			{
+				//evaluation consumes the constants of the expression, so it is run on a copy, as neo_evaluate does.
+				vector< token_t > v;
+				clone_postfix(postfix, v);
+				token_t t = evaluate_postfix(v, s, st);
+				if(t.type == OP_OBJECT && t.objectp && t.objectp->get_refcount() == 0)
+					object::object_reap(t.objectp);
+			}
+		}
+	private:
+		const char* script;
+		const char* expression;
+		vector< token_t > postfix;
+		stack< token_t > s;
+		symboltable st;
+};
+
+//creates and reaps an object. lists are created with 8 integer elements. one operation creates one object.
+class object_benchmark : public benchmark
+{
+	public:
+		object_benchmark(const char* n, object_type_t t) : benchmark(n), type(t) {}
+
+		void run(size_t n)
+		{
+			for(size_t i = 0; i < n; ++i)
+			{
+				object* o = NULL;
+				switch(type)
+				{
+					case OBJECT_INTEGER: o = object::create_object((int) i); break;
+					case OBJECT_FLOAT  : o = object::create_object(i + 0.5); break;
+					case OBJECT_STRING : o = object::create_object("benchmark"); break;
+					case OBJECT_LIST   :
+						o = object::create_object(OBJECT_LIST);
+						for(int j = 0; j < 8; ++j)
+							object::add_object_to_list(o, object::create_object(j));
+						break;
+					default:
+						continue;
+				}
+				object::object_reap(o);
+			}
+		}
+	private:
+		object_type_t type;
+};
+
+//concatenates two strings or two lists of the given length. one operation creates one concatenation.
+class concat_benchmark : public benchmark
+{
+	public:
+		concat_benchmark(const char* n, object_type_t t, size_t l) : benchmark(n), type(t), length(l) {}
+
+		void setup()
+		{
+			if(type == OBJECT_STRING)
+			{
+				string s(length, 'x');
+				operand = object::create_object(s.c_str());
+			}
+			else
+			{
+				operand = object::create_object(OBJECT_LIST);
+				for(size_t i = 0; i < length; ++i)
+					object::add_object_to_list(operand, object::create_object((int) i));
+			}
+		}
+
+		void teardown() { object::object_reap(operand); }
+
+		void run(size_t n)
+		{
+			for(size_t i = 0; i < n; ++i)
+				object::object_reap(*operand + *operand);
+		}
+	private:
+		object_type_t type;
+		size_t length;
+		object* operand;
+};
+
+//swaps the case of, or searches, a string of the given length which holds the needle 'needle' at its end. one
+//operation evaluates the operator once.
+class string_benchmark : public benchmark
+{
+	public:
+		string_benchmark(const char* n, operator_t o, size_t l) : benchmark(n), op(o), length(l) {}
+
+		void setup()
+		{
+			string s(length - 6, 'x');
+			s += "needle";
+			operand = object::create_object(s.c_str());
+			needle = object::create_object("needle");
+		}
+
+		void teardown()
+		{
+			object::object_reap(operand);
+			object::object_reap(needle);
+		}
+
+		void run(size_t n)
+		{
+			for(size_t i = 0; i < n; ++i)
+			{
+				object* r = (op == OP_FIND) ? find_string(*operand, *needle) : ~*operand;
+				object::object_reap(r);
+			}
+		}
+	private:
+		operator_t op;
+		size_t length;
+		object* operand;
+		object* needle;
+};
+
+//looks up variables of a symbol table with the given number of variables, in a pseudo random order. one operation
+//looks up one variable.
+class lookup_benchmark : public benchmark
+{
+	public:
+#define LOOKUP_ORDER_LENGTH (4096)
+		lookup_benchmark(const char* n, size_t c) : benchmark(n), count(c) {}
+
+		void setup()
+		{
+			names.reserve(count);
+			for(size_t i = 0; i < count; ++i)
+			{
+				//variable names are made of lowercase letters only.
+				char name[8];
+				size_t v = i;
+				for(int j = 0; j < 5; ++j, v /= 26)
+					name[j] = 'a' + (v % 26);
+				name[5] = '\0';
+				names.push_back(name);
+
+				object* o = object::create_object((int) i);
+				o->increment_refcount();
+				st.set_symbol(names.back(), o);
+			}
+
+			unsigned int seed = 12345;
+			for(int i = 0; i < LOOKUP_ORDER_LENGTH; ++i)
+			{
+				seed = seed * 1103515245 + 12345;
+				order.push_back((seed >> 8) % count);
+			}
+		}
+
+		void teardown()
+		{
+			st.clear();
+			names.clear();
+			order.clear();
+		}
+
+		void run(size_t n)
+		{
+			object_pointer_t value;
+			size_t found = 0;
+			for(size_t i = 0; i < n; ++i)
+				found += st.get_symbol(names[order[i % LOOKUP_ORDER_LENGTH]], value);
+			sink = found;
+		}
+#undef LOOKUP_ORDER_LENGTH
+	private:
+		size_t count;
+		vector< string > names;
+		vector< size_t > order;
+		symboltable st;
+};
+
+//runs b and prints its result.
+static void measure(benchmark& b, double min_time, bool last)
+{
+#define MAX_GROWTH (100)
+	b.setup();
+
+	size_t n = 1;
+	double elapsed;
+	unsigned long long a, bytes;
+	while(true)
+	{
+		a = allocations_so_far();
+		bytes = allocated_bytes_so_far();
+		double start = now();
+		b.run(n);
+		elapsed = now() - start;
+		a = allocations_so_far() - a;
+		bytes = allocated_bytes_so_far() - bytes;
+		if(elapsed >= min_time)
+			break;
+
+		//aim a little past the minimum time, so that the next run is usually the last one.
+		double next = (elapsed > 0) ? n * 1.2 * min_time / elapsed : n * MAX_GROWTH;
+		if(next > (double) n * MAX_GROWTH)
+			next = (double) n * MAX_GROWTH;
+		n = (next > n) ? (size_t) next : n + 1;
+	}
+
+	b.teardown();
+
+	printf("{\"name\": \"%s\", \"operations\": %lu, \"ns_per_op\": %.2f, \"allocs_per_op\": %.2f, \"bytes_per_op\": %.2f}%s\n",
+		b.name, (unsigned long) n, elapsed / n, (double) a / n, (double) bytes / n, last ? "" : ",");
+	fflush(stdout);
+#undef MAX_GROWTH
+}
+
+int main(int argc, char* argv[])
+{
+	double min_time = 0.5;
+	const char* filter = "";
+	for(int i = 1; i < argc; ++i)
+	{
+		if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			min_time = atof(argv[++i]);
+		else
+			filter = argv[i];
+	}
+
+	//the order of the benchmarks is part of the output format. add new benchmarks at the end.
+	const char numeric[] = "a = 7\nb = 3\nc = 2.5\nd = 11\ne = 2\nf = 4";
+	const char strings[] = "s = 'Hello'\nt = 'World'";
+	const char lists[] = "l = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16}\nm = {'a', 'b', 'c', 'd'}";
+	benchmark* benchmarks[] =
+	{
+		new tokenize_benchmark("tokenize/operators", "alpha = beta + gamma * (delta - epsilon) / zeta % eta & theta | iota ^ kappa"),
+		new tokenize_benchmark("tokenize/literals", "12345 + 3.25 * 'hello world' - 7 + {1, 2, 3, 'abc'}"),
+		new infix_to_postfix_benchmark("compile/infix_to_postfix", "a = b + c * (d - e) / f % g & h | i ^ ~j"),
+		new evaluate_benchmark("evaluate/numeric", numeric, "a * b + c - d / e % f"),
+		new evaluate_benchmark("evaluate/string", strings, "s + ~t"),
+		new evaluate_benchmark("evaluate/list", lists, "l + m + 1"),
+		new object_benchmark("object/integer", OBJECT_INTEGER),
+		new object_benchmark("object/float", OBJECT_FLOAT),
+		new object_benchmark("object/string", OBJECT_STRING),
+		new object_benchmark("object/list", OBJECT_LIST),
+		new concat_benchmark("concat/string/16", OBJECT_STRING, 16),
+		new concat_benchmark("concat/string/1024", OBJECT_STRING, 1024),
+		new concat_benchmark("concat/string/65536", OBJECT_STRING, 65536),
+		new concat_benchmark("concat/list/16", OBJECT_LIST, 16),
+		new concat_benchmark("concat/list/1024", OBJECT_LIST, 1024),
+		new concat_benchmark("concat/list/65536", OBJECT_LIST, 65536),
+		new lookup_benchmark("symbols/lookup/10", 10),
+		new lookup_benchmark("symbols/lookup/10000", 10000),
+		new lookup_benchmark("symbols/lookup/1000000", 1000000),
+		new string_benchmark("string/swap_case/16", OP_BITWISE_NOT, 16),
+		new string_benchmark("string/swap_case/65536", OP_BITWISE_NOT, 65536),
+		new string_benchmark("string/find/16", OP_FIND, 16),
+		new string_benchmark("string/find/65536", OP_FIND, 65536)
+	};
+	const int count = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+	vector< benchmark* > selected;
+	for(int i = 0; i < count; ++i)
+		if(strstr(benchmarks[i]->name, filter))
+			selected.push_back(benchmarks[i]);
+
+	printf("{\"version\": 1, \"min_time_s\": %.2f, \"benchmarks\": [\n", min_time);
+	for(size_t i = 0; i < selected.size(); ++i)
+		measure(*selected[i], min_time * 1e9, i == selected.size() - 1);
+	printf("]}\n");
+
+	for(int i = 0; i < count; ++i)
+		delete benchmarks[i];
+	return 0;
+}
@@ -1,10 +1,40 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 #include <stack>
 #include <vector>
 #include <map>
+#include <set>
+#include <list>
+#include <deque>
+#include <algorithm>
 #include <string>
+#if __cplusplus >= 201703L
+#include <charconv>
+#endif
+
+#include "neo.h"
 
 using namespace std;
 
@@ -33,17 +63,25 @@ typedef enum
 	OP_SEPARATOR = 16,
 
 	OP_INVALID = 17,
+
+	OP_LOAD = 18,
+	OP_BIND = 19,
+
+	OP_EQUAL = 20,
+	OP_LESS = 21,
+	OP_GREATER = 22,
+	OP_FIND = 23,
 	OP_EOF //signifies the end of token stream.
 } operator_t;
 
 bool is_evaluation_operator(const operator_t& op)
 {
-	return ((op >= OP_ADD) && (op <= OP_BITWISE_NOT));
+	return ((op >= OP_ADD) && (op <= OP_BITWISE_NOT)) || op == OP_LOAD || ((op >= OP_EQUAL) && (op <= OP_FIND));
 }
 
 bool is_unary_operator(const operator_t& op)
 {
-	return (op == OP_BITWISE_NOT);
+	return (op == OP_BITWISE_NOT || op == OP_LOAD);
 }
 
 const char* operator_strings[] =
@@ -71,6 +109,14 @@ const char* operator_strings[] =
 	",",
 
 	"INVALID",
+
+	"@",
+	":=",
+
+	"==",
+	"<",
+	">",
+	"?",
 	"EOF"
 };
 
@@ -82,7 +128,10 @@ typedef enum
 	ERROR_UNEXPECTED_END_OF_EXPRESSION = 3,
 	ERROR_BAD_EXPRESSION = 4,
 	ERROR_PARSING_ERROR = 5,
-	ERROR_UNDEFINED_OPERATOR = 6
+	ERROR_UNDEFINED_OPERATOR = 6,
+	ERROR_BUDGET_EXCEEDED = 7,
+	ERROR_CANNOT_LOAD = 8,
+	ERROR_CIRCULAR_BINDING = 9
 } error_type_t;
 
 const char* error_codes[] =
@@ -93,7 +142,10 @@ const char* error_codes[] =
 	"unexpected end of expression",
 	"improperly formed expression",
 	"parsing error",
-	"operator undefined"
+	"operator undefined",
+	"evaluation budget exceeded",
+	"cannot load file",
+	"variable bound to an expression which reads it"
 };
 
 typedef enum
@@ -114,1001 +166,6391 @@ const char* object_type_strings[] =
 	"dummy"
 };
 
-typedef void* object_handle_t;
+//nanoseconds since an arbitrary point in the past.
+uint64_t monotonic_ns()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
 
-class object
+/*
+Tracing of the phases of the interpreter, for flame charts of slow evaluations. Every thread records spans (a name, a
+start time and a duration) into a ring buffer of its own, which keeps the latest events once it is full. The trace of
+all threads is written as Chrome trace event JSON, which chrome://tracing and Perfetto display.
+Tracing is compiled in and toggled at runtime. While it is off a span costs one load and one branch.
+*/
+class tracer
 {
 	public:
-		//objects are created in one of the following ways.
-		static object* create_object(int v);
-		static object* create_object(double v);
-		static object* create_object(const char* s);
-		static object* create_object(object_type_t t);
-		static object* clone_object(const object* o);
+		static bool enabled() { return __builtin_expect(__atomic_load_n(&tracing, __ATOMIC_RELAXED), 0); }
 
-		//list processing functions.
-		static void add_object_to_list(object* list, object* o);
-		static void clone_and_add_to_list(object* list, object* l);
+		//starting leaves out the events of an earlier trace.
+		static void start();
+		static void stop() { __atomic_store_n(&tracing, false, __ATOMIC_RELAXED); }
 
-		static void object_reap(object* o);
+		//writes the events of all threads. events of threads still tracing at the time may be incomplete.
+		static bool write(FILE* out);
 
-		static void debug_string(const object* o, char* buffer, int bufferlength);
-		static void print_memory_stats();
+		//records a span, or an event without duration. arg_name may be NULL, name and arg_name must be static
+		//strings.
+		static void record(const char* name, uint64_t start, uint64_t duration, const char* arg_name = NULL,
+			uint64_t arg = 0) { add('X', name, start, duration, arg_name, arg); }
+		static void instant(const char* name, const char* arg_name = NULL, uint64_t arg = 0)
+		{
+			add('i', name, monotonic_ns(), 0, arg_name, arg);
+		}
 
-		//refcount determines when an object is deleted.
-		void increment_refcount();
-		void decrement_refcount();
+	private:
+#define TRACE_BUFFER_EVENTS (64 * 1024)
+		struct event
+		{
+			char type; //X for spans, i for instant events.
+			const char* name;
+			const char* arg_name;
+			uint64_t start;
+			uint64_t duration;
+			uint64_t arg;
+		};
+		struct buffer
+		{
+			int thread;
+			uint64_t written; //events recorded, of which the latest TRACE_BUFFER_EVENTS are kept.
+			event events[TRACE_BUFFER_EVENTS];
+		};
 
-		void print_object(bool verbose = false, char tchar = '\n');
+		static bool tracing;
+		static uint64_t origin; //start of the trace.
+		static __thread buffer* thread_buffer;
 
-		//the following binary operators are defined for an object.
-#define PROTOTYPE_OPERATOR_FUNCTION(op) \
-		friend object* operator op (object& lhs, object& rhs);
+		//buffers of all threads that recorded events, never freed so that traces outlive their threads.
+		static vector< buffer* > buffers;
+		static pthread_mutex_t buffers_lock;
 
-		PROTOTYPE_OPERATOR_FUNCTION(+)
-		PROTOTYPE_OPERATOR_FUNCTION(-)
-		PROTOTYPE_OPERATOR_FUNCTION(*)
-		PROTOTYPE_OPERATOR_FUNCTION(/)
-		PROTOTYPE_OPERATOR_FUNCTION(%)
-		PROTOTYPE_OPERATOR_FUNCTION(&)
-		PROTOTYPE_OPERATOR_FUNCTION(|)
-		PROTOTYPE_OPERATOR_FUNCTION(^)
+		static void add(char type, const char* name, uint64_t start, uint64_t duration, const char* arg_name,
+			uint64_t arg);
+};
 
-#undef  PROTOTYPE_OPERATOR_FUNCTION
+bool tracer::tracing = false;
+uint64_t tracer::origin = 0;
+__thread tracer::buffer* tracer::thread_buffer = NULL;
+vector< tracer::buffer* > tracer::buffers;
+pthread_mutex_t tracer::buffers_lock = PTHREAD_MUTEX_INITIALIZER;
 
-		//the following unary operators are defined for an object.
-		friend object* operator ~ (object& rhs);
+void tracer::start()
+{
+	pthread_mutex_lock(&buffers_lock);
+	origin = monotonic_ns();
+	pthread_mutex_unlock(&buffers_lock);
+	__atomic_store_n(&tracing, true, __ATOMIC_RELAXED);
+}
 
-	private:
-		object_type_t type;
-		union {
-			object_handle_t handle;
-			int intvalue;
-			double floatvalue;
-		};
-		int refcount;
+void tracer::add(char type, const char* name, uint64_t start, uint64_t duration, const char* arg_name, uint64_t arg)
+{
+	buffer* b = thread_buffer;
+	if(b == NULL)
+	{
+		b = new buffer();
+		b->written = 0;
+		pthread_mutex_lock(&buffers_lock);
+		b->thread = buffers.size() + 1;
+		buffers.push_back(b);
+		pthread_mutex_unlock(&buffers_lock);
+		thread_buffer = b;
+	}
 
-		static int object_count[OBJECT_TYPE_COUNT];
-		static size_t object_memory_alloc;
-		static size_t object_memory_freed;
+	uint64_t n = __atomic_load_n(&b->written, __ATOMIC_RELAXED);
+	event& e = b->events[n % TRACE_BUFFER_EVENTS];
+	e.type = type;
+	e.name = name;
+	e.arg_name = arg_name;
+	e.start = start;
+	e.duration = duration;
+	e.arg = arg;
+	__atomic_store_n(&b->written, n + 1, __ATOMIC_RELEASE);
+}
 
-		object() : refcount(0) { ++object_count[OBJECT_STRING]; }
+bool tracer::write(FILE* out)
+{
+	int pid = getpid();
+	fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
 
-		object(int v) : type(OBJECT_INTEGER), intvalue(v), refcount(0) { ++object_count[OBJECT_INTEGER]; }
-		object(double v) : type(OBJECT_FLOAT), floatvalue(v), refcount(0) { ++object_count[OBJECT_FLOAT]; }
-		object(const char* s) : type(OBJECT_STRING), refcount(0)
-		{
-			size_t n = strlen(s) + 1;
-			this->handle = new char[ n ];
-			strcpy((char*) this->handle, s);
-			++object_count[OBJECT_STRING];
-			object_memory_alloc += n;
-		}
-		object(object_type_t t) : type(t), refcount(0)
+	pthread_mutex_lock(&buffers_lock);
+	bool first = true;
+	for(int i = 0; i < buffers.size(); ++i)
+	{
+		const buffer* b = buffers[i];
+		uint64_t n = __atomic_load_n(&b->written, __ATOMIC_ACQUIRE);
+		for(uint64_t j = (n > TRACE_BUFFER_EVENTS) ? n - TRACE_BUFFER_EVENTS : 0; j < n; ++j)
 		{
-			switch(t)
-			{
-				case OBJECT_INTEGER: intvalue = 0; break;
-				case OBJECT_FLOAT  : floatvalue = (double) 0; break;
-				case OBJECT_STRING :
-				case OBJECT_LIST   :
-					this->handle = new vector<object*> () ;
-			}
-			++object_count[t];
+			const event& e = b->events[j % TRACE_BUFFER_EVENTS];
+			//events recorded before the trace started are left out.
+			if(e.start < origin)
+				continue;
+			fprintf(out, "%s{\"name\": \"%s\", \"cat\": \"neo\", \"ph\": \"%c\", \"ts\": %.3f, ", first ? "" : ",\n",
+				e.name, e.type, (e.start - origin) / 1000.0);
+			if(e.type == 'X')
+				fprintf(out, "\"dur\": %.3f, ", e.duration / 1000.0);
+			else
+				fprintf(out, "\"s\": \"t\", ");
+			fprintf(out, "\"pid\": %d, \"tid\": %d", pid, b->thread);
+			if(e.arg_name)
+				fprintf(out, ", \"args\": {\"%s\": %llu}", e.arg_name, (unsigned long long) e.arg);
+			fprintf(out, "}");
+			first = false;
 		}
+	}
+	pthread_mutex_unlock(&buffers_lock);
 
-		~object() {}
+	fprintf(out, "\n]}\n");
+	return !ferror(out);
+}
 
-		double object_to_double()
+#undef TRACE_BUFFER_EVENTS
+
+//traces the lifetime of the scope as a span, if tracing is on when the scope is entered.
+class trace_span
+{
+	public:
+		trace_span(const char* n) : name(n), arg_name(NULL), arg(0), start(tracer::enabled() ? monotonic_ns() : 0) {}
+		~trace_span()
 		{
-			return (type == OBJECT_INTEGER) ? (double) intvalue : (type == OBJECT_FLOAT ? floatvalue : (double)0 );
+			if(start)
+				tracer::record(name, start, monotonic_ns() - start, arg_name, arg);
 		}
-};
 
-typedef object* object_pointer_t;
-typedef vector <object_pointer_t> * object_list_pointer_t;
+		//attaches a count, like the number of tokens or elements processed, to the span.
+		void set_arg(const char* n, uint64_t v) { arg_name = n; arg = v; }
 
-//initialize static members of the class object.
-int object::object_count[OBJECT_TYPE_COUNT] = { 0 };
-size_t object::object_memory_alloc = 0;
-size_t object::object_memory_freed = 0;
+	private:
+		const char* name;
+		const char* arg_name;
+		uint64_t arg;
+		uint64_t start;
+};
 
-object* object::create_object(int v)
+/*
+A histogram of latencies in nanoseconds, in the manner of HdrHistogram. Values below 16 have a bucket each. Above
+that every power of two is split into 8 linear sub-buckets, so that a value is recorded with a relative error of at
+most 12.5% over the whole range, in a fixed amount of memory.
+*/
+class latency_histogram
 {
-#ifdef DEBUG_NEO
-	object* x;
-	x = new object(v);
-	printf("creating ");
-	x->print_object(true, '\n');
-	return x;
-#else
-	return new object(v);
-#endif
-}
+	public:
+#define HISTOGRAM_SUB_BUCKET_BITS (3)
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_MAX_EXPONENT (47) //larger values, of more than 3 days, are recorded as 2^48 - 1.
+#define HISTOGRAM_BUCKETS (2 * HISTOGRAM_SUB_BUCKETS + (HISTOGRAM_MAX_EXPONENT - HISTOGRAM_SUB_BUCKET_BITS) * HISTOGRAM_SUB_BUCKETS)
+		latency_histogram() : count(0), sum(0), max(0) { memset(buckets, 0, sizeof(buckets)); }
 
-object* object::create_object(double v)
-{
-#ifdef DEBUG_NEO
-	object* x;
-	x = new object(v);
-	printf("creating ");
-	x->print_object(true, '\n');
-	return x;
-#else
-	return new object(v);
-#endif
-}
+		//records are atomic for histograms of concurrent isolates.
+		void record(uint64_t v, bool atomic);
 
-object* object::create_object(const char* s)
+		//the highest value of the bucket holding the pth percentile of the values recorded (0 < p <= 100).
+		uint64_t percentile(double p) const;
+
+		uint64_t count;
+		uint64_t sum;
+		uint64_t max;
+
+	private:
+		uint64_t buckets[HISTOGRAM_BUCKETS];
+
+		static int bucket_of(uint64_t v);
+		static uint64_t highest_value_of(int b);
+};
+
+int latency_histogram::bucket_of(uint64_t v)
 {
-#ifdef DEBUG_NEO
-	object* x;
-	x = new object(s);
-	printf("creating ");
-	x->print_object(true, '\n');
-	return x;
-#else
-	return new object(s);
-#endif
+	if(v < 2 * HISTOGRAM_SUB_BUCKETS)
+		return (int) v;
+	if(v >> (HISTOGRAM_MAX_EXPONENT + 1))
+		v = ((uint64_t) 1 << (HISTOGRAM_MAX_EXPONENT + 1)) - 1;
+
+	int e = 63 - __builtin_clzll(v);
+	int sub = (int) (v >> (e - HISTOGRAM_SUB_BUCKET_BITS)) - HISTOGRAM_SUB_BUCKETS;
+	return 2 * HISTOGRAM_SUB_BUCKETS + (e - HISTOGRAM_SUB_BUCKET_BITS - 1) * HISTOGRAM_SUB_BUCKETS + sub;
 }
 
-object* object::create_object(object_type_t t)
+uint64_t latency_histogram::highest_value_of(int b)
 {
-#ifdef DEBUG_NEO
-	object* x;
-	x = new object(t);
-	printf("creating ");
-	x->print_object(true, '\n');
-	return x;
-#else
-	return new object(t);
-#endif
+	if(b < 2 * HISTOGRAM_SUB_BUCKETS)
+		return b;
+	b -= 2 * HISTOGRAM_SUB_BUCKETS;
+	int e = b / HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKET_BITS + 1;
+	uint64_t lowest = (uint64_t) (HISTOGRAM_SUB_BUCKETS + b % HISTOGRAM_SUB_BUCKETS) << (e - HISTOGRAM_SUB_BUCKET_BITS);
+	return lowest + ((uint64_t) 1 << (e - HISTOGRAM_SUB_BUCKET_BITS)) - 1;
 }
 
-object* object::clone_object(const object* o)
+void latency_histogram::record(uint64_t v, bool atomic)
 {
-	switch(o->type)
+	int b = bucket_of(v);
+	if(atomic)
 	{
-		case OBJECT_INTEGER: return object::create_object(o->intvalue);
-		case OBJECT_FLOAT  : return object::create_object(o->floatvalue);
-		case OBJECT_STRING : return object::create_object((const char*) o->handle);
-		case OBJECT_LIST   : 
-		{
-			//to clone a list, create a new list and add objects to the new list by cloning each element of the
-			//old list.
-			object * newobject = object::create_object(OBJECT_LIST);
-			newobject->handle = new vector <object_pointer_t> ();
-			object_list_pointer_t dst = (object_list_pointer_t) newobject->handle;
-
-			object_list_pointer_t src = (object_list_pointer_t) o->handle;
-			
-			for(int i = 0; i < src->size(); ++i)
-				dst->push_back(clone_object((*src)[i]));
-
-			return newobject;
-		}
+		__sync_fetch_and_add(&buckets[b], 1);
+		__sync_fetch_and_add(&count, 1);
+		__sync_fetch_and_add(&sum, v);
+		uint64_t m = __atomic_load_n(&max, __ATOMIC_RELAXED);
+		while(v > m && !__atomic_compare_exchange_n(&max, &m, v, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			;
 	}
-	return NULL;
-}
-
-//begin list processing functions.
-void object::add_object_to_list(object* list, object* o)
-{
-	if(list->type == OBJECT_LIST)
+	else
 	{
-		((vector <object*> *) list->handle)->push_back(o);
+		++buckets[b];
+		++count;
+		sum += v;
+		if(v > max)
+			max = v;
 	}
 }
 
-void object::clone_and_add_to_list(object* list, object* l)
+uint64_t latency_histogram::percentile(double p) const
 {
-	if(list->type == OBJECT_LIST && l->type == OBJECT_LIST)
+	uint64_t rank = (uint64_t) (count * p / 100 + 0.5), seen = 0;
+	if(rank == 0)
+		rank = 1;
+	for(int b = 0; b < HISTOGRAM_BUCKETS; ++b)
 	{
-		object_list_pointer_t dst = (object_list_pointer_t) list->handle;
-		object_list_pointer_t src = (object_list_pointer_t) l->handle;
-
-		for(int i = 0; i < src->size(); ++i)
-			dst->push_back( object::clone_object((*src)[i]) );
+		seen += buckets[b];
+		if(seen >= rank)
+			return (highest_value_of(b) < max) ? highest_value_of(b) : max;
 	}
-	else if(list->type == OBJECT_LIST)
-		((object_list_pointer_t) list->handle)->push_back( object::clone_object(l) );
+	return max;
 }
 
-//end list processing functions.
+#undef HISTOGRAM_BUCKETS
+#undef HISTOGRAM_MAX_EXPONENT
+#undef HISTOGRAM_SUB_BUCKETS
+#undef HISTOGRAM_SUB_BUCKET_BITS
 
-void object::increment_refcount()
+//phases of running an expression, of which the latencies are recorded.
+typedef enum
 {
-	++refcount;
-}
+	PHASE_TOKENIZE = 0,
+	PHASE_COMPILE = 1,
+	PHASE_EVALUATE = 2,
+	PHASE_COUNT = 3
+} phase_t;
 
-void object::decrement_refcount()
+const char* phase_strings[] =
 {
-	if(--refcount == 0)
-		object_reap(this);
-}
+	"tokenize",
+	"compile",
+	"evaluate"
+};
 
-void object::object_reap(object* o)
+/*
+An isolate keeps the heap of one thread of evaluation: statistics of the objects created in it and a cache of freed
+object storage. Every thread evaluates in its current isolate (one of its own, unless it entered another), so
+threads working on separate symbol tables never touch each other's state.
+A concurrent isolate is entered by several threads at once. Its statistics are updated atomically and the objects
+created in it are shared, i.e. their refcounts are updated atomically too.
+*/
+class isolate
 {
-	if(o->refcount == 0)
-	{
-#ifdef DEBUG_NEO
-		printf("destroying ");
-		o->print_object(true, '\n');
-#endif
-		if(o->type == OBJECT_STRING)
-		{
-			object_memory_freed += strlen((const char*) o->handle) + 1;
-			delete [] ((char*) o->handle);
-		}
-		else if(o->type == OBJECT_LIST)
+	public:
+		isolate(bool is_concurrent = false);
+		~isolate();
+
+		const bool concurrent;
+
+		//statistics of the objects created in this isolate. objects reaped in another isolate than the one they
+		//were created in are counted there, so only the sum over all isolates is exact in that case.
+		uint64_t objects_created[OBJECT_TYPE_COUNT];
+		int64_t objects_live[OBJECT_TYPE_COUNT];
+		size_t object_memory_alloc; //bytes of objects, strings and list storage.
+		size_t object_memory_freed;
+
+		void count_object(object_type_t t)
 		{
-			vector <object*> * v = (vector <object*> *) o->handle;
-			if(v)
+			if(concurrent)
 			{
-				for(int i = 0; i < v->size(); ++i)
-					delete (*v)[i];
+				__sync_fetch_and_add(&objects_created[t], 1);
+				__sync_fetch_and_add(&objects_live[t], 1);
+			}
+			else
+			{
+				++objects_created[t];
+				++objects_live[t];
 			}
-			delete v;
 		}
-		delete o;
-	}
-}
+		void count_reaped(object_type_t t)
+		{
+			if(concurrent) __sync_fetch_and_sub(&objects_live[t], 1); else --objects_live[t];
+		}
+		void count_alloc(size_t n)
+		{
+#define TRACE_LARGE_ALLOCATION (64 * 1024) //bytes from which allocations are traced.
+			if(n >= TRACE_LARGE_ALLOCATION && tracer::enabled())
+				tracer::instant("allocation", "bytes", n);
+#undef TRACE_LARGE_ALLOCATION
+			if(concurrent) __sync_fetch_and_add(&object_memory_alloc, n); else object_memory_alloc += n;
+			//an isolate may free more than it allocated, reaping objects created in another one.
+			if(memory_limit && object_memory_alloc > object_memory_freed &&
+				object_memory_alloc - object_memory_freed > memory_limit)
+				budget_exceeded = true;
+		}
+		//bytes of strings and list storage, which are counted by the type of object owning them, too.
+		uint64_t payload_alloc[OBJECT_TYPE_COUNT];
+		void count_payload(object_type_t t, size_t n)
+		{
+			count_alloc(n);
+			if(concurrent) __sync_fetch_and_add(&payload_alloc[t], n); else payload_alloc[t] += n;
+		}
 
-void object::debug_string(const object* o, char* buffer, int bufferlength)
-{
-	switch(o->type)
-	{
-		case OBJECT_STRING:
-		if(bufferlength)
+		void count_freed(size_t n)
 		{
-			strncpy(buffer, (const char*) o->handle, bufferlength);
-			buffer[bufferlength - 1] = '\0';
+			if(concurrent) __sync_fetch_and_add(&object_memory_freed, n); else object_memory_freed += n;
 		}
-		break;
 
-		case OBJECT_INTEGER:
-		if(bufferlength)
+		//operators evaluated, and latencies of the phases of running expressions.
+		uint64_t operator_count[OP_EOF];
+		latency_histogram latency[PHASE_COUNT];
+
+		void count_operator(operator_t op)
 		{
-			snprintf(buffer, bufferlength, "%d", o->intvalue);
-			buffer[bufferlength - 1] = '\0';
+			if(concurrent) __sync_fetch_and_add(&operator_count[op], 1); else ++operator_count[op];
 		}
-		break;
+		void record_latency(phase_t p, uint64_t ns) { latency[p].record(ns, concurrent); }
 
-		case OBJECT_FLOAT:
-		if(bufferlength)
+		//objects and payload bytes of each type created in the process so far: those of isolates which have been
+		//deleted, and of the current isolate.
+		static void allocation_totals(uint64_t created[OBJECT_TYPE_COUNT], uint64_t payload[OBJECT_TYPE_COUNT]);
+
+		//prints the statistics of the isolate for people, or as a JSON object.
+		void print_metrics(FILE* out) const;
+		string metrics_json() const;
+
+		//budgets of the evaluation running in the isolate, 0 stands for no limit. an evaluation exceeding either of
+		//them is aborted. budgets apply to isolates which are not concurrent.
+		size_t instruction_limit;
+		size_t memory_limit;  //bytes in use by the objects of the isolate.
+		size_t instructions;  //executed since the budget was set.
+		bool budget_exceeded;
+
+		void set_budget(size_t instruction_budget, size_t memory_budget)
 		{
-			snprintf(buffer, bufferlength, "%.2f", o->floatvalue);
-			buffer[bufferlength - 1] = '\0';
+			instruction_limit = instruction_budget;
+			memory_limit = memory_budget;
+			instructions = 0;
+			budget_exceeded = false;
 		}
-		break;
+
+		//accounts for n units of work, such as an operator evaluated or an object cloned. returns false once the
+		//budget is exceeded.
+		bool charge(size_t n)
+		{
+			if(concurrent)
+				return true;
+			instructions += n;
+			if(instruction_limit && instructions > instruction_limit)
+				budget_exceeded = true;
+			return !budget_exceeded;
+		}
+
+		//storage for objects.
+		void* allocate_object(size_t n);
+		void free_object(void* p, size_t n);
+
+		//allocations served from the free list, which do not call operator new.
+		uint64_t reused_blocks;
+		uint64_t reused_bytes;
+
+		static isolate* current() { return current_isolate ? current_isolate : thread_isolate(); }
+
+		//makes i the current isolate of the calling thread and returns the previous one.
+		static isolate* enter(isolate* i)
+		{
+			isolate* previous = current_isolate;
+			current_isolate = i;
+			return previous;
+		}
+
+	private:
+#define ISOLATE_FREE_LIST_LIMIT (64 * 1024)
+		struct free_block { free_block* next; };
+		free_block* free_list;
+		size_t free_count;
+
+		static __thread isolate* current_isolate;
+
+		//allocations of deleted isolates.
+		static uint64_t retired_created[OBJECT_TYPE_COUNT];
+		static uint64_t retired_payload[OBJECT_TYPE_COUNT];
+
+		//every thread has an isolate of its own, which is current unless the thread entered another one.
+		static __thread isolate* default_isolate;
+		static pthread_key_t default_isolate_key;
+		static pthread_once_t default_isolate_once;
+
+		static isolate* thread_isolate();
+		static void create_default_isolate_key();
+		static void delete_default_isolate(void* i) { delete (isolate*) i; }
+};
+
+__thread isolate* isolate::current_isolate = NULL;
+uint64_t isolate::retired_created[OBJECT_TYPE_COUNT];
+uint64_t isolate::retired_payload[OBJECT_TYPE_COUNT];
+__thread isolate* isolate::default_isolate = NULL;
+pthread_key_t isolate::default_isolate_key;
+pthread_once_t isolate::default_isolate_once = PTHREAD_ONCE_INIT;
+
+void isolate::create_default_isolate_key()
+{
+	pthread_key_create(&default_isolate_key, isolate::delete_default_isolate);
+}
+
+isolate* isolate::thread_isolate()
+{
+	if(default_isolate == NULL)
+	{
+		pthread_once(&default_isolate_once, isolate::create_default_isolate_key);
+		default_isolate = new isolate();
+		pthread_setspecific(default_isolate_key, default_isolate);
 	}
+	return default_isolate;
 }
 
-void object::print_memory_stats()
+isolate::isolate(bool is_concurrent) : concurrent(is_concurrent), object_memory_alloc(0), object_memory_freed(0),
+	instruction_limit(0), memory_limit(0), instructions(0), budget_exceeded(false), reused_blocks(0), reused_bytes(0),
+	free_list(NULL), free_count(0)
 {
-	printf("total memory allocated=%ld bytes, freed=%ld bytes, inuse=%ld bytes\n", object_memory_alloc, object_memory_freed,
-	object_memory_alloc - object_memory_freed);
-	for(int i = OBJECT_INTEGER; i < OBJECT_TYPE_COUNT; ++i)
-		printf("total objects of type %-10s=%10d\n", object_type_strings[i], object_count[i]);
+	memset(objects_created, 0, sizeof(objects_created));
+	memset(objects_live, 0, sizeof(objects_live));
+	memset(payload_alloc, 0, sizeof(payload_alloc));
+	memset(operator_count, 0, sizeof(operator_count));
 }
 
-void object::print_object(bool verbose, char tchar)
+isolate::~isolate()
 {
-	if(verbose)
+	while(free_list)
 	{
-		printf("object@ %p type=%s reference_count=%d ", this, object_type_strings[this->type], this->refcount);
+		free_block* b = free_list;
+		free_list = b->next;
+		::operator delete(b);
 	}
-	switch(this->type)
+
+	for(int i = 0; i < OBJECT_TYPE_COUNT; ++i)
 	{
-		case OBJECT_INTEGER: printf("%d", this->intvalue); break;
-		case OBJECT_FLOAT:   printf("%.2f", this->floatvalue); break;
-		case OBJECT_STRING:  printf("'%s' length=%ld", (const char*)this->handle, strlen((const char*)this->handle)); break;
-		case OBJECT_LIST:
-			printf("{");
-			vector <object* > * v = (vector <object* > *) this->handle;
-			size_t vs = v->size();
-			for(int i = 0; i < vs; ++i)
-			{
-				char t = (i == (vs - 1)) ? ' ' : ',' ;
-				((*v)[i])->print_object(false, t);
-			}
-			printf("} length=%ld", vs);
-			break;
+		__sync_fetch_and_add(&retired_created[i], objects_created[i]);
+		__sync_fetch_and_add(&retired_payload[i], payload_alloc[i]);
 	}
-	printf("%c", tchar);
 }
 
-#define OPERATOR_FUNCTION(op) \
-object* operator op (object& lhs, object& rhs) \
-{ \
-	object* result = NULL; \
-	if(lhs.type == OBJECT_INTEGER && rhs.type == OBJECT_INTEGER) \
-	{ \
-		result = object::create_object(lhs.intvalue op rhs.intvalue); \
-	} \
-	return result; \
+void isolate::allocation_totals(uint64_t created[OBJECT_TYPE_COUNT], uint64_t payload[OBJECT_TYPE_COUNT])
+{
+	const isolate* heap = current();
+	for(int i = 0; i < OBJECT_TYPE_COUNT; ++i)
+	{
+		created[i] = __atomic_load_n(&retired_created[i], __ATOMIC_RELAXED) + heap->objects_created[i];
+		payload[i] = __atomic_load_n(&retired_payload[i], __ATOMIC_RELAXED) + heap->payload_alloc[i];
+	}
 }
 
-#define OPERATOR_INTEGER_FLOAT_FUNCTION(op) \
-object* operator op (object& lhs, object& rhs) \
-{ \
-	object* result = NULL; \
-	if(lhs.type == OBJECT_INTEGER && rhs.type == OBJECT_INTEGER) \
-		result = object::create_object(lhs.intvalue op rhs.intvalue); \
-	else if(#op == "+" && lhs.type == OBJECT_STRING && rhs.type == OBJECT_STRING) \
-	{ \
-		/*for efficiency, create the object using private constructor and set up type and handle.*/ \
-		result = new object(); \
-		result->type = OBJECT_STRING; \
-		size_t n = strlen((const char*)lhs.handle) + strlen((const char*)rhs.handle) + 1; \
-		result->handle = new char [ n ]; \
-		strcpy((char*) result->handle, (const char*)lhs.handle); \
-		strcpy(((char*) result->handle) + strlen((const char*)result->handle), (const char*)rhs.handle); \
-		object::object_memory_alloc += n; \
-	} \
-	else if(#op == "+" && (lhs.type == OBJECT_LIST || rhs.type == OBJECT_LIST)) \
-	{ \
-		object& list  = (lhs.type == OBJECT_LIST ? lhs : rhs); \
-		object& other = (lhs.type == OBJECT_LIST ? rhs : lhs); \
-\
-		if(lhs.type == OBJECT_LIST && rhs.type == OBJECT_LIST) \
-		{ \
-			/*create a new list, from the elements of lhs and rhs lists and return the new list.*/ \
-			result = object::create_object(OBJECT_LIST); \
-			object::clone_and_add_to_list(result, &lhs); \
-			object::clone_and_add_to_list(result, &rhs); \
-		} \
-		else \
-		{ \
-			result = object::create_object(OBJECT_LIST); \
-			if(&lhs == &other) \
-			{ \
-				object::clone_and_add_to_list(result, &other); \
-				object::clone_and_add_to_list(result, &list); \
-			} \
-			else \
-			{ \
-				object::clone_and_add_to_list(result, &list); \
-				object::clone_and_add_to_list(result, &other); \
-			} \
-		} \
-	} \
-	else if((lhs.type == OBJECT_INTEGER || lhs.type == OBJECT_FLOAT) && \
-		(rhs.type == OBJECT_INTEGER || rhs.type == OBJECT_FLOAT)) \
-		result = object::create_object(lhs.object_to_double() op rhs.object_to_double()); \
-\
-	return result; \
+void isolate::print_metrics(FILE* out) const
+{
+	fprintf(out, "total memory allocated=%ld bytes, freed=%ld bytes, inuse=%ld bytes\n", object_memory_alloc,
+		object_memory_freed, (long) (object_memory_alloc - object_memory_freed));
+	for(int i = OBJECT_INTEGER; i < OBJECT_TYPE_COUNT; ++i)
+		fprintf(out, "objects of type %-10s live=%10lld total=%10llu payload=%12llu bytes\n", object_type_strings[i],
+			(long long) objects_live[i], (unsigned long long) objects_created[i], (unsigned long long) payload_alloc[i]);
+	for(int i = 0; i < OP_EOF; ++i)
+		if(is_evaluation_operator((operator_t) i))
+			fprintf(out, "operator %-5s evaluated=%10llu\n", operator_strings[i], (unsigned long long) operator_count[i]);
+	for(int i = 0; i < PHASE_COUNT; ++i)
+	{
+		const latency_histogram& h = latency[i];
+		fprintf(out, "latency of %-8s count=%llu mean=%lluns p50=%lluns p90=%lluns p99=%lluns p99.9=%lluns max=%lluns\n",
+			phase_strings[i], (unsigned long long) h.count, (unsigned long long) (h.count ? h.sum / h.count : 0),
+			(unsigned long long) h.percentile(50), (unsigned long long) h.percentile(90),
+			(unsigned long long) h.percentile(99), (unsigned long long) h.percentile(99.9), (unsigned long long) h.max);
+	}
 }
 
-object* operator % (object& lhs, object& rhs)
+/*
+The statistics as one line of JSON, for monitoring tools. Keys are never renamed or removed, new ones may be added.
+*/
+string isolate::metrics_json() const
 {
-	object* result = NULL;
-	if(lhs.type == OBJECT_INTEGER && rhs.type == OBJECT_INTEGER)
-		result = object::create_object(lhs.intvalue % rhs.intvalue);
-	//% is undefined for floating point values in C. However neo defines % analogous to how it operates for an integer.
-	else if((lhs.type == OBJECT_INTEGER || lhs.type == OBJECT_FLOAT) &&
-		(rhs.type == OBJECT_INTEGER || rhs.type == OBJECT_FLOAT))
+	char buffer[256];
+	string json;
+
+	snprintf(buffer, sizeof(buffer), "{\"memory\": {\"allocated\": %lu, \"freed\": %lu, \"in_use\": %ld}, \"objects\": {",
+		(unsigned long) object_memory_alloc, (unsigned long) object_memory_freed,
+		(long) (object_memory_alloc - object_memory_freed));
+	json += buffer;
+	for(int i = OBJECT_INTEGER; i < OBJECT_TYPE_COUNT; ++i)
 	{
-		double l = lhs.object_to_double(), r = rhs.object_to_double();
-		result = object::create_object(l - ((long)(l / r) * r));
+		snprintf(buffer, sizeof(buffer), "%s\"%s\": {\"live\": %lld, \"total\": %llu, \"payload_bytes\": %llu}",
+			i ? ", " : "", object_type_strings[i], (long long) objects_live[i], (unsigned long long) objects_created[i],
+			(unsigned long long) payload_alloc[i]);
+		json += buffer;
 	}
 
-	return result;
+	json += "}, \"operators\": {";
+	bool first = true;
+	for(int i = 0; i < OP_EOF; ++i)
+	{
+		if(!is_evaluation_operator((operator_t) i))
+			continue;
+		snprintf(buffer, sizeof(buffer), "%s\"%s\": %llu", first ? "" : ", ", operator_strings[i],
+			(unsigned long long) operator_count[i]);
+		json += buffer;
+		first = false;
+	}
+
+	json += "}, \"latency_ns\": {";
+	for(int i = 0; i < PHASE_COUNT; ++i)
+	{
+		const latency_histogram& h = latency[i];
+		snprintf(buffer, sizeof(buffer), "%s\"%s\": {\"count\": %llu, \"sum\": %llu, \"p50\": %llu, \"p90\": %llu, "
+			"\"p99\": %llu, \"p999\": %llu, \"max\": %llu}", i ? ", " : "", phase_strings[i],
+			(unsigned long long) h.count, (unsigned long long) h.sum, (unsigned long long) h.percentile(50),
+			(unsigned long long) h.percentile(90), (unsigned long long) h.percentile(99),
+			(unsigned long long) h.percentile(99.9), (unsigned long long) h.max);
+		json += buffer;
+	}
+	json += "}}";
+	return json;
 }
 
-OPERATOR_INTEGER_FLOAT_FUNCTION(+)
-OPERATOR_INTEGER_FLOAT_FUNCTION(-)
-OPERATOR_INTEGER_FLOAT_FUNCTION(*)
-OPERATOR_INTEGER_FLOAT_FUNCTION(/)
-OPERATOR_FUNCTION(&)
-OPERATOR_FUNCTION(|)
-OPERATOR_FUNCTION(^)
+//all objects are of the same size, so storage freed by one object can be reused by the next one as it is.
+void* isolate::allocate_object(size_t n)
+{
+	count_alloc(n);
+	if(free_list == NULL || concurrent)
+		return ::operator new(n);
 
-#undef OPERATOR_INTEGER_FLOAT_FUNCTION
-#undef OPERATOR_FUNCTION
+	free_block* b = free_list;
+	free_list = b->next;
+	--free_count;
+	++reused_blocks;
+	reused_bytes += n;
+	return b;
+}
 
-object* operator ~ (object& rhs)
+//objects may be freed in another isolate than the one they were created in, as every block is allocated on its own.
+void isolate::free_object(void* p, size_t n)
 {
-	object* result = NULL;
-	if(rhs.type == OBJECT_INTEGER)
-	{
-		result = object::create_object(~rhs.intvalue);
-	} else if(rhs.type == OBJECT_STRING)
+	count_freed(n);
+	if(concurrent || free_count >= ISOLATE_FREE_LIST_LIMIT)
 	{
-		result = new object();
-		result->type = OBJECT_STRING;
-		result->handle = new char [strlen((const char*) rhs.handle) + 1];
-		int i;
-		for(i = 0; i < strlen((const char*) rhs.handle); ++i)
-		{
-			char c = *(((const char*) rhs.handle) + i);
-			((char*) result->handle)[i] = isupper(c) ? tolower(c) : toupper(c);
-		}
-		((char*) result->handle)[i] = '\0';		
+		::operator delete(p);
+		return;
 	}
-	return result;
+
+	free_block* b = (free_block*) p;
+	b->next = free_list;
+	free_list = b;
+	++free_count;
 }
 
-class token
+#undef ISOLATE_FREE_LIST_LIMIT
+
+//enters an isolate for the lifetime of the scope.
+class isolate_scope
 {
 	public:
-#define VARIABLE_NAME_LENGTH (31)
-	operator_t type;
-	union {
-		object_pointer_t objectp; 		//valid only for OP_OBJECT.
-		char varname[VARIABLE_NAME_LENGTH + 1]; //valid only for OP_VARIABLE.
-		int error_code; 			//valid only for OP_INVALID.
-	};
+		isolate_scope(isolate* i) : previous(isolate::enter(i)) {}
+		~isolate_scope() { isolate::enter(previous); }
+	private:
+		isolate* previous;
+};
 
-	token() { objectp = NULL; }
-#undef VARIABLE_NAME_LENGTH
+/*
+Where the thread is in the script, for the sampling profiler: the line being run and what is being done for it.
+Drivers set the line, phase timers and evaluate_postfix set the activity. The profiler's signal handler reads the
+point of the thread it interrupts, so plain stores to volatile fields are all it takes.
+*/
+class profile_point
+{
+	public:
+		volatile uint32_t line; //0 outside of scripts.
+
+#define PROFILE_IDLE (-1)
+		//a phase_t, PHASE_COUNT + an operator_t while an operator is evaluated, or PROFILE_IDLE.
+		volatile int activity;
 };
-typedef token token_t;
 
-void print_token(const token_t& t)
+__thread profile_point profile_here = { 0, PROFILE_IDLE };
+
+/*
+Records the time from its construction to its destruction as a latency of a phase, in the current isolate.
+The phase is the activity of the thread for the profiler meanwhile.
+*/
+class phase_timer
 {
-	switch(t.type)
+	public:
+		phase_timer(phase_t p) : phase(p), start(monotonic_ns()), excluded(NULL), excluded_start(0), carried(NULL),
+			deferred(false), previous_activity(profile_here.activity) { profile_here.activity = p; }
+		~phase_timer();
+
+		//leaves out the time counted in *e meanwhile, such as the time spent waiting for input.
+		void exclude(const uint64_t* e) { excluded = e; excluded_start = *e; }
+
+		//adds the time in *c, carried over from earlier parts of the phase. once deferred, the time is added to *c
+		//rather than recorded, for the part of the phase still to come.
+		void carry(uint64_t* c) { carried = c; }
+		void defer() { deferred = true; }
+
+	private:
+		phase_t phase;
+		uint64_t start;
+		const uint64_t* excluded;
+		uint64_t excluded_start;
+		uint64_t* carried;
+		bool deferred;
+		int previous_activity;
+};
+
+phase_timer::~phase_timer()
+{
+	profile_here.activity = previous_activity;
+	uint64_t elapsed = monotonic_ns() - start;
+	if(excluded)
+		elapsed -= *excluded - excluded_start;
+	if(carried)
 	{
-		case OP_OBJECT:
-			printf("token: type=%s p=%p\n", operator_strings[t.type], t.objectp);
-			break;
-		case OP_VARIABLE:
-			printf("token: type=%s reference=%s\n", operator_strings[t.type], t.varname);
-			break;
-		case OP_INVALID:
-			printf("token: type=%s error=%s\n", operator_strings[t.type], error_codes[t.error_code]);
-			break;
-		default:
-			printf("token: type=%s\n", operator_strings[t.type]);
+		elapsed += *carried;
+		*carried = deferred ? elapsed : 0;
+		if(deferred)
+			return;
 	}
+	isolate::current()->record_latency(phase, elapsed);
 }
 
-class symboltable
+typedef void* object_handle_t;
+
+class object;
+
+/*
+Read-only storage of a list of numbers, used in place of a vector of objects: the elements of a binary file mapped
+into memory, or a column read from a CSV file. The elements are not objects, so loading a dataset costs neither an
+allocation nor a parse per element. Lists share the storage when they are cloned. An element becomes an object only
+when the list is copied into a vector of objects (when it is concatenated, say, or before it is modified); readers of
+the list otherwise use the numbers in place.
+*/
+struct mapped_array
+{
+	object_type_t element_type; //OBJECT_INTEGER for int32_t elements, OBJECT_FLOAT for double elements.
+	size_t length;
+	const void* elements;
+	void* mapping;       //of the file, or NULL if the elements were read into memory allocated with malloc.
+	size_t mapping_size;
+	int refcount;        //lists sharing the storage.
+};
+
+/*
+The text of a string follows a header with its length. Strings are immutable, so a clone of a string shares the text
+of the original, and the header counts the objects referring to it.
+Interned texts are also kept in the intern table, which holds one text for each distinct content, so that equal
+interned strings share their text and strings with different interned texts differ. String literals and the strings
+stored in lists are interned.
+*/
+struct string_text
+{
+	string_text* next; //in the same bucket of the intern table.
+	size_t length;
+	uint32_t hash;     //set once the text is interned.
+	bool interned;
+	int refcount;
+	char text[1];
+
+	//a text of the given length, with one reference, whose bytes are still to be written. interned texts are shared
+	//by every isolate, so they are counted by the intern table rather than by the isolate creating them.
+	static string_text* create(size_t length, bool counted = true);
+	static string_text* of(const void* text) { return (string_text*) ((char*) text - offsetof(string_text, text)); }
+
+	void retain() { __sync_add_and_fetch(&refcount, 1); }
+	void release();
+};
+
+class intern_table
 {
 	public:
-		bool get_symbol(const string& var, object_pointer_t& value);
-		void set_symbol(const string& var, object_pointer_t value);
+		//returns the interned text with the given content, with a reference for the caller.
+		static string_text* intern(const char* s, size_t length);
+
+		//returns the interned text with the content of t, with a reference for the caller. the reference to t is
+		//given up.
+		static string_text* intern(string_text* t);
+
+		static void print_stats(FILE* out);
 
-		void print_all_symbols();
 	private:
-		map < string, object_pointer_t > st;
+		friend struct string_text;
+#define INTERN_SHARDS (16)
+		//the shard of a text is picked by the highest bits of its hash, its bucket by the lowest ones.
+		struct shard
+		{
+			int busy; //spin lock, held for a lookup, an insertion or a removal.
+			size_t count;
+			size_t bytes;
+			vector< string_text* > buckets;
+		};
+		static shard shards[INTERN_SHARDS];
+
+		static uint32_t hash(const char* s, size_t length);
+		static shard& shard_of(uint32_t h) { return shards[h >> 28]; }
+		static void lock(shard& s) { while(__sync_lock_test_and_set(&s.busy, 1)) sched_yield(); }
+		static void unlock(shard& s) { __sync_lock_release(&s.busy); }
+		static string_text* find(shard& s, const char* text, size_t length, uint32_t h);
+		static void insert(shard& s, string_text* t);
+		static void remove(shard& s, string_text* t);
 };
 
-bool symboltable::get_symbol(const string& var, object_pointer_t& value)
+intern_table::shard intern_table::shards[INTERN_SHARDS];
+
+string_text* string_text::create(size_t length, bool counted)
 {
-	map < string, object_pointer_t > :: iterator i = st.find(var);
-	if(i == st.end())
-		return false;
-	else
+	size_t n = offsetof(string_text, text) + length + 1;
+	string_text* t = (string_text*) new char[n];
+	t->next = NULL;
+	t->length = length;
+	t->hash = 0;
+	t->interned = false;
+	t->refcount = 1;
+	t->text[length] = '\0';
+	if(counted)
+		isolate::current()->count_payload(OBJECT_STRING, n);
+	return t;
+}
+
+void string_text::release()
+{
+	if(interned)
 	{
-		value = (*i).second;
-		return true;
+		//only the last reference is given up under the lock, so that a lookup cannot find a text being freed.
+		for(int n = __atomic_load_n(&refcount, __ATOMIC_RELAXED); n > 1; n = __atomic_load_n(&refcount, __ATOMIC_RELAXED))
+			if(__sync_bool_compare_and_swap(&refcount, n, n - 1))
+				return;
+		intern_table::shard& s = intern_table::shard_of(hash);
+		intern_table::lock(s);
+		bool last = (__sync_sub_and_fetch(&refcount, 1) == 0);
+		if(last)
+			intern_table::remove(s, this);
+		intern_table::unlock(s);
+		if(last)
+			delete [] (char*) this;
+		return;
 	}
+	if(__sync_sub_and_fetch(&refcount, 1) != 0)
+		return;
+	isolate::current()->count_freed(offsetof(string_text, text) + length + 1);
+	delete [] (char*) this;
 }
 
-void symboltable::set_symbol(const string& var, object_pointer_t value)
+//FNV-1a.
+uint32_t intern_table::hash(const char* s, size_t length)
 {
-	st[var] = value;
+	uint32_t h = 2166136261u;
+	for(size_t i = 0; i < length; ++i)
+		h = (h ^ (unsigned char) s[i]) * 16777619u;
+	return h;
 }
 
-void symboltable::print_all_symbols()
+string_text* intern_table::find(shard& s, const char* text, size_t length, uint32_t h)
 {
-	map < string, object_pointer_t > :: iterator i = st.begin(), j = st.end();	
+	if(s.buckets.empty())
+		return NULL;
+	for(string_text* t = s.buckets[h & (s.buckets.size() - 1)]; t != NULL; t = t->next)
+		if(t->hash == h && t->length == length && memcmp(t->text, text, length) == 0)
+			return t;
+	return NULL;
+}
 
-	printf("symbol table <begin>\n");
-	while(i != j)
+void intern_table::insert(shard& s, string_text* t)
+{
+#define INTERN_MIN_BUCKETS (64)
+	//the number of buckets doubles once there are more texts than buckets.
+	if(s.count >= s.buckets.size())
 	{
-		printf("%s = %p\n", (*i).first.c_str(), (*i).second);
-		++i;
+		vector< string_text* > buckets(s.buckets.empty() ? INTERN_MIN_BUCKETS : 2 * s.buckets.size(), NULL);
+		for(size_t i = 0; i < s.buckets.size(); ++i)
+			for(string_text* u = s.buckets[i], *next; u != NULL; u = next)
+			{
+				next = u->next;
+				u->next = buckets[u->hash & (buckets.size() - 1)];
+				buckets[u->hash & (buckets.size() - 1)] = u;
+			}
+		s.buckets.swap(buckets);
 	}
-	printf("symbol Table <end>\n");
+	string_text*& head = s.buckets[t->hash & (s.buckets.size() - 1)];
+	t->next = head;
+	head = t;
+	++s.count;
+	s.bytes += t->length + 1;
+#undef INTERN_MIN_BUCKETS
 }
 
-/*
-Read one token from istream and populate the token structure pointed by t.
-Advance and return the incoming pointer so that it points to the next token in the stream.
-*/
-const char* get_next_token(const char* istream, token_t* t)
+void intern_table::remove(shard& s, string_text* t)
 {
-	if(istream == NULL) return NULL;
-	t->type = OP_EOF;
-
-	//Skip white space.
-	while(*istream != '\0' && (*istream == ' ' || *istream == '\n' || *istream == '\t'))
-		++istream;
-	if(*istream == '\0') return NULL;
-
-	t->type = OP_INVALID;
-	t->error_code = ERROR_PARSING_ERROR;
+	string_text** p = &s.buckets[t->hash & (s.buckets.size() - 1)];
+	while(*p != t)
+		p = &(*p)->next;
+	*p = t->next;
+	--s.count;
+	s.bytes -= t->length + 1;
+}
 
-	//Look for operators.
-	switch(*istream)
+string_text* intern_table::intern(const char* text, size_t length)
+{
+	uint32_t h = hash(text, length);
+	shard& s = shard_of(h);
+	lock(s);
+	string_text* t = find(s, text, length, h);
+	if(t)
+		t->retain();
+	else
 	{
-		case '+' : t->type = OP_ADD; break;
-		case '-' : t->type = OP_SUBTRACT; break;
-		case '*' : t->type = OP_MULTIPLY; break;
-		case '/' : t->type = OP_DIVIDE; break;
-		case '%' : t->type = OP_MODULO; break;	
-		case '=' : t->type = OP_ASSIGN; break;
-		case '&' : t->type = OP_BITWISE_AND; break;
-		case '|' : t->type = OP_BITWISE_OR; break;
-		case '^' : t->type = OP_BITWISE_XOR; break;
-		case '~' : t->type = OP_BITWISE_NOT; break;
-		case '(' : t->type = OP_OPEN_SCOPE; break;
-		case ')' : t->type = OP_CLOSE_SCOPE; break;
-		case '{' : t->type = OP_OPEN_BRACE; break;
-		case '}' : t->type = OP_CLOSE_BRACE; break;
-		case ',' : t->type = OP_SEPARATOR; break;
+		t = string_text::create(length, false);
+		memcpy(t->text, text, length);
+		t->hash = h;
+		t->interned = true;
+		insert(s, t);
 	}
+	unlock(s);
+	return t;
+}
 
-	//Look for an integer literal.
-	if(isdigit(*istream) || (*istream == '-' && isdigit(istream[1])))
+string_text* intern_table::intern(string_text* t)
+{
+	if(t->interned)
+		return t;
+	uint32_t h = hash(t->text, t->length);
+	shard& s = shard_of(h);
+	lock(s);
+	string_text* u = find(s, t->text, t->length, h);
+	if(u)
+		u->retain();
+	else if(__atomic_load_n(&t->refcount, __ATOMIC_ACQUIRE) == 1)
 	{
-		char * r = NULL;
-		double v = strtod(istream, &r);
-		int v_int = (int) v;
-
-		t->type = OP_OBJECT;
-		if(v - v_int == 0)
-			t->objectp = object::create_object(v_int);
-		else
-			t->objectp = object::create_object(v);
-
-		if(r == istream)
-			istream = istream + strlen(istream); 
-		else
-			istream = --r;
+		//no other object refers to t, so it can become the interned text itself. it is handed over to the table by
+		//the isolate of the object referring to it, which is the one that counted it unless the object moved.
+		t->hash = h;
+		t->interned = true;
+		insert(s, t);
+		unlock(s);
+		isolate::current()->count_freed(offsetof(string_text, text) + t->length + 1);
+		return t;
 	}
+	unlock(s);
+	if(u == NULL)
+		u = intern(t->text, t->length);
+	t->release();
+	return u;
+}
 
-	//Look for a string literal (enclosed in '').
-	if(*istream == '\'')
+void intern_table::print_stats(FILE* out)
+{
+	size_t count = 0, bytes = 0;
+	for(int i = 0; i < INTERN_SHARDS; ++i)
 	{
-		const char* r = istream + 1;
-		char buffer[64] = { 0 };
-		int k = 0;
-		while(*r != '\0' && *r != '\'')
-		{
-			buffer[k++] = *r;
-			++r;
-		}
-		if(*r == '\0')
-			goto skip_reading_literal;
-		else
-		{
-			buffer[k] = '\0';
-			t->type = OP_OBJECT;
-			t->objectp = object::create_object((const char*) buffer);
-			istream = r;
-		}
+		lock(shards[i]);
+		count += shards[i].count;
+		bytes += shards[i].bytes;
+		unlock(shards[i]);
 	}
-	
-skip_reading_literal:
-	//Look for a variable name
-	if(*istream >= 'a' && *istream <= 'z')
-	{
+	fprintf(out, "interned strings=%lu bytes=%lu\n", (unsigned long) count, (unsigned long) bytes);
+}
+#undef INTERN_SHARDS
+
+class object
+{
+	public:
+		//objects are created in one of the following ways.
+		static object* create_object(int v);
+		static object* create_object(double v);
+		static object* create_object(const char* s);
+		static object* create_interned(const char* s, size_t length);
+		static object* create_object(object_type_t t);
+		static object* clone_object(const object* o);
+
+		//list processing functions.
+		static void add_object_to_list(object* list, object* o);
+		static void reserve_list(object* list, size_t n);
+		static void clone_and_add_to_list(object* list, object* l);
+
+		//creates a read-only list of the int32_t or double values (in the byte order of the machine) of a binary
+		//file, or of the numbers in a column of a CSV file. returns NULL if the file cannot be loaded.
+		static object* map_list(const char* path, object_type_t element_type);
+		static object* load_csv_column(const char* path, int column);
+
+		static void object_reap(object* o);
+
+		//marks o (and the elements of a list) as shared between isolates.
+		static void share(object* o);
+
+		static string debug_string(const object* o);
+		static void print_memory_stats();
+
+		//objects are allocated from the current isolate.
+		static void* operator new(size_t n) { return isolate::current()->allocate_object(n); }
+		static void operator delete(void* p, size_t n) { isolate::current()->free_object(p, n); }
+
+		//refcount determines when an object is deleted.
+		void increment_refcount();
+		void decrement_refcount();
+		int get_refcount() const { return refcount; }
+
+		void print_object(bool verbose = false, char tchar = '\n', FILE* out = stdout);
+
+		//accessors for the value of an object.
+		object_type_t get_type() const { return type; }
+		int get_integer() const { return (type == OBJECT_FLOAT) ? (int) floatvalue : (type == OBJECT_INTEGER ? intvalue : 0); }
+		double get_float() const { return object_to_double(); }
+		const char* get_string() const { return (type == OBJECT_STRING) ? (const char*) handle : NULL; }
+		size_t get_string_length() const { return (type == OBJECT_STRING) ? string_text::of(handle)->length : 0; }
+		size_t get_list_length() const;
+		//NULL for lists with mapped storage, whose elements are not objects.
+		const object* get_list_item(size_t i) const;
+		const mapped_array* get_mapped_array() const;
+
+		//a list with its own copy of length elements of element_type, see mapped_array.
+		static object* create_array_list(object_type_t element_type, size_t length, const void* elements);
+
+		//the following binary operators are defined for an object.
+#define PROTOTYPE_OPERATOR_FUNCTION(op) \
+		friend object* operator op (object& lhs, object& rhs);
+
+		PROTOTYPE_OPERATOR_FUNCTION(+)
+		PROTOTYPE_OPERATOR_FUNCTION(-)
+		PROTOTYPE_OPERATOR_FUNCTION(*)
+		PROTOTYPE_OPERATOR_FUNCTION(/)
+		PROTOTYPE_OPERATOR_FUNCTION(%)
+		PROTOTYPE_OPERATOR_FUNCTION(&)
+		PROTOTYPE_OPERATOR_FUNCTION(|)
+		PROTOTYPE_OPERATOR_FUNCTION(^)
+		PROTOTYPE_OPERATOR_FUNCTION(==)
+		PROTOTYPE_OPERATOR_FUNCTION(<)
+		PROTOTYPE_OPERATOR_FUNCTION(>)
+
+#undef  PROTOTYPE_OPERATOR_FUNCTION
+
+		//the following unary operators are defined for an object.
+		friend object* operator ~ (object& rhs);
+
+		friend class value_formatter;
+
+	private:
+		object_type_t type;
+#define OBJECT_SHARED (1) //refcount is updated atomically.
+#define OBJECT_MAPPED (2) //a list whose handle is a mapped_array rather than a vector.
+		unsigned char flags;
+		union {
+			object_handle_t handle;
+			int intvalue;
+			double floatvalue;
+		};
+		int refcount;
+
+		//objects created in a concurrent isolate are shared.
+		static unsigned char initial_flags() { return isolate::current()->concurrent ? OBJECT_SHARED : 0; }
+
+		object(int v) : type(OBJECT_INTEGER), flags(initial_flags()), intvalue(v), refcount(0) { isolate::current()->count_object(OBJECT_INTEGER); }
+		object(double v) : type(OBJECT_FLOAT), flags(initial_flags()), floatvalue(v), refcount(0) { isolate::current()->count_object(OBJECT_FLOAT); }
+		object(const char* s) : type(OBJECT_STRING), flags(initial_flags()), refcount(0)
+		{
+			size_t n = strlen(s);
+			string_text* t = string_text::create(n);
+			memcpy(t->text, s, n);
+			this->handle = t->text;
+			isolate::current()->count_object(OBJECT_STRING);
+		}
+		//the object takes over the reference of the caller to t.
+		object(string_text* t) : type(OBJECT_STRING), flags(initial_flags()), handle(t->text), refcount(0)
+		{
+			isolate::current()->count_object(OBJECT_STRING);
+		}
+		object(object_type_t t) : type(t), flags(initial_flags()), refcount(0)
+		{
+			switch(t)
+			{
+				case OBJECT_INTEGER: intvalue = 0; break;
+				case OBJECT_FLOAT  : floatvalue = (double) 0; break;
+				case OBJECT_STRING :
+				case OBJECT_LIST   :
+					this->handle = new vector<object*> () ;
+					isolate::current()->count_payload(t, sizeof(vector<object*>));
+			}
+			isolate::current()->count_object(t);
+		}
+
+		object(mapped_array* a) : type(OBJECT_LIST), flags(initial_flags() | OBJECT_MAPPED), handle(a), refcount(0)
+		{
+			__sync_add_and_fetch(&a->refcount, 1);
+			isolate::current()->count_object(OBJECT_LIST);
+		}
+
+		~object() {}
+
+		//replaces the text of a string by the interned text with the same content.
+		static void intern(object* o)
+		{
+			if(o->type == OBJECT_STRING && !string_text::of(o->handle)->interned)
+				o->handle = intern_table::intern(string_text::of(o->handle))->text;
+		}
+
+		//compares the bytes of two strings with memcmp, a string ordering before the longer strings it is a prefix
+		//of, so that embedded NULs are compared like any other byte. compares only for equality if ordered is false.
+		static int compare_strings(const object& lhs, const object& rhs, bool ordered);
+
+		//functions of lists with mapped storage.
+		static object* create_element(const mapped_array* a, size_t i);
+		static void release_array(mapped_array* a);
+		static void unmap_list(object* list);
+		static object* create_mapped_list(object_type_t element_type, size_t length, const void* elements,
+			void* mapping, size_t mapping_size);
+
+		double object_to_double() const
+		{
+			return (type == OBJECT_INTEGER) ? (double) intvalue : (type == OBJECT_FLOAT ? floatvalue : (double)0 );
+		}
+
+		//accounts for the storage of a list growing or shrinking from 'before' to 'after' elements.
+		static void list_storage_changed(size_t before, size_t after)
+		{
+			if(after > before)
+				isolate::current()->count_payload(OBJECT_LIST, (after - before) * sizeof(object*));
+			else if(before > after)
+				isolate::current()->count_freed((before - after) * sizeof(object*));
+		}
+};
+
+inline size_t object::get_list_length() const
+{
+	if(type != OBJECT_LIST)
+		return 0;
+	return (flags & OBJECT_MAPPED) ? ((const mapped_array*) handle)->length : ((const vector<object*> *) handle)->size();
+}
+
+inline const object* object::get_list_item(size_t i) const
+{
+	if(i >= get_list_length())
+		return NULL;
+	return (flags & OBJECT_MAPPED) ? NULL : (*(const vector<object*> *) handle)[i];
+}
+
+inline const mapped_array* object::get_mapped_array() const
+{
+	return (type == OBJECT_LIST && (flags & OBJECT_MAPPED)) ? (const mapped_array*) handle : NULL;
+}
+
+typedef object* object_pointer_t;
+typedef vector <object_pointer_t> * object_list_pointer_t;
+
+object* object::create_object(int v)
+{
+#ifdef DEBUG_NEO
+	object* x;
+	x = new object(v);
+	printf("creating ");
+	x->print_object(true, '\n');
+	return x;
+#else
+	return new object(v);
+#endif
+}
+
+object* object::create_object(double v)
+{
+#ifdef DEBUG_NEO
+	object* x;
+	x = new object(v);
+	printf("creating ");
+	x->print_object(true, '\n');
+	return x;
+#else
+	return new object(v);
+#endif
+}
+
+object* object::create_object(const char* s)
+{
+#ifdef DEBUG_NEO
+	object* x;
+	x = new object(s);
+	printf("creating ");
+	x->print_object(true, '\n');
+	return x;
+#else
+	return new object(s);
+#endif
+}
+
+object* object::create_interned(const char* s, size_t length)
+{
+	return new object(intern_table::intern(s, length));
+}
+
+object* object::create_object(object_type_t t)
+{
+#ifdef DEBUG_NEO
+	object* x;
+	x = new object(t);
+	printf("creating ");
+	x->print_object(true, '\n');
+	return x;
+#else
+	return new object(t);
+#endif
+}
+
+object* object::clone_object(const object* o)
+{
+	switch(o->type)
+	{
+		case OBJECT_INTEGER: return object::create_object(o->intvalue);
+		case OBJECT_FLOAT  : return object::create_object(o->floatvalue);
+		case OBJECT_STRING :
+			string_text::of(o->handle)->retain();
+			return new object(string_text::of(o->handle));
+		case OBJECT_LIST   : 
+		{
+			//lists with mapped storage are read-only, so their clones share the storage.
+			if(o->flags & OBJECT_MAPPED)
+				return new object((mapped_array*) o->handle);
+
+			//to clone a list, create a new list and add objects to the new list by cloning each element of the
+			//old list.
+			object * newobject = object::create_object(OBJECT_LIST);
+			object_list_pointer_t dst = (object_list_pointer_t) newobject->handle;
+
+			object_list_pointer_t src = (object_list_pointer_t) o->handle;
+			trace_span span("clone");
+			span.set_arg("elements", src->size());
+			dst->reserve(src->size());
+			list_storage_changed(0, dst->capacity());
+
+			//cloning stops short once the budget of the evaluation is exceeded.
+			for(int i = 0; i < src->size() && isolate::current()->charge(1); ++i)
+				dst->push_back(clone_object((*src)[i]));
+
+			return newobject;
+		}
+	}
+	return NULL;
+}
+
+//begin list processing functions.
+void object::add_object_to_list(object* list, object* o)
+{
+	if(list->type == OBJECT_LIST)
+	{
+		if(list->flags & OBJECT_MAPPED)
+			unmap_list(list);
+		//lists often hold the same strings many times over, which then share one text.
+		intern(o);
+		object_list_pointer_t v = (object_list_pointer_t) list->handle;
+		size_t capacity = v->capacity();
+		v->push_back(o);
+		if(v->capacity() != capacity)
+			list_storage_changed(capacity, v->capacity());
+	}
+}
+
+void object::reserve_list(object* list, size_t n)
+{
+	if(list->type == OBJECT_LIST)
+	{
+		if(list->flags & OBJECT_MAPPED)
+			unmap_list(list);
+		object_list_pointer_t v = (object_list_pointer_t) list->handle;
+		size_t capacity = v->capacity();
+		v->reserve(n);
+		list_storage_changed(capacity, v->capacity());
+	}
+}
+
+void object::clone_and_add_to_list(object* list, object* l)
+{
+	if(list->type == OBJECT_LIST && l->type == OBJECT_LIST && (l->flags & OBJECT_MAPPED))
+	{
+		mapped_array* src = (mapped_array*) l->handle;
+		trace_span span("clone");
+		span.set_arg("elements", src->length);
+		reserve_list(list, list->get_list_length() + src->length);
+
+		object_list_pointer_t dst = (object_list_pointer_t) list->handle;
+		for(size_t i = 0; i < src->length && isolate::current()->charge(1); ++i)
+			dst->push_back(create_element(src, i));
+	}
+	else if(list->type == OBJECT_LIST && l->type == OBJECT_LIST)
+	{
+		object_list_pointer_t src = (object_list_pointer_t) l->handle;
+		trace_span span("clone");
+		span.set_arg("elements", src->size());
+		reserve_list(list, list->get_list_length() + src->size());
+
+		object_list_pointer_t dst = (object_list_pointer_t) list->handle;
+		for(int i = 0; i < src->size() && isolate::current()->charge(1); ++i)
+			dst->push_back( object::clone_object((*src)[i]) );
+	}
+	else if(list->type == OBJECT_LIST)
+		add_object_to_list(list, object::clone_object(l));
+}
+
+object* object::create_element(const mapped_array* a, size_t i)
+{
+	if(a->element_type == OBJECT_INTEGER)
+		return create_object((int) ((const int32_t*) a->elements)[i]);
+	return create_object(((const double*) a->elements)[i]);
+}
+
+object* object::create_mapped_list(object_type_t element_type, size_t length, const void* elements, void* mapping,
+	size_t mapping_size)
+{
+	mapped_array* a = new mapped_array;
+	a->element_type = element_type;
+	a->length = length;
+	a->elements = elements;
+	a->mapping = mapping;
+	a->mapping_size = mapping_size;
+	a->refcount = 0;
+
+	//only elements read into memory are counted, the pages of a mapped file belong to the page cache.
+	size_t element_size = (element_type == OBJECT_INTEGER) ? sizeof(int32_t) : sizeof(double);
+	isolate::current()->count_payload(OBJECT_LIST, sizeof(mapped_array) + (mapping ? 0 : length * element_size));
+	return new object(a);
+}
+
+void object::release_array(mapped_array* a)
+{
+	if(__sync_sub_and_fetch(&a->refcount, 1) != 0)
+		return;
+
+	size_t element_size = (a->element_type == OBJECT_INTEGER) ? sizeof(int32_t) : sizeof(double);
+	isolate::current()->count_freed(sizeof(mapped_array) + (a->mapping ? 0 : a->length * element_size));
+	if(a->mapping)
+		munmap(a->mapping, a->mapping_size);
+	else
+		free((void*) a->elements);
+	delete a;
+}
+
+//copy on write: the storage of a list is copied to a vector of objects before the list is modified.
+void object::unmap_list(object* list)
+{
+	mapped_array* a = (mapped_array*) list->handle;
+	object_list_pointer_t v = new vector<object*>();
+	isolate::current()->count_payload(OBJECT_LIST, sizeof(vector<object*>));
+	v->reserve(a->length);
+	list_storage_changed(0, v->capacity());
+	for(size_t i = 0; i < a->length; ++i)
+	{
+		v->push_back(create_element(a, i));
+		if(list->flags & OBJECT_SHARED)
+			share(v->back());
+	}
+
+	list->handle = v;
+	list->flags &= ~OBJECT_MAPPED;
+	release_array(a);
+}
+
+object* object::create_array_list(object_type_t element_type, size_t length, const void* elements)
+{
+	size_t size = length * ((element_type == OBJECT_INTEGER) ? sizeof(int32_t) : sizeof(double));
+	void* copy = malloc(size ? size : 1);
+	if(copy == NULL)
+		return NULL;
+	memcpy(copy, elements, size);
+	return create_mapped_list(element_type, length, copy, NULL, 0);
+}
+
+//maps the file path read-only, and sets size. returns NULL if the file cannot be mapped.
+static void* map_file(const char* path, size_t& size)
+{
+	int fd = open(path, O_RDONLY);
+	if(fd < 0)
+		return NULL;
+
+	struct stat sb;
+	void* p = MAP_FAILED;
+	if(fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0)
+		p = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(p == MAP_FAILED)
+		return NULL;
+	size = sb.st_size;
+	return p;
+}
+
+object* object::map_list(const char* path, object_type_t element_type)
+{
+	size_t element_size = (element_type == OBJECT_INTEGER) ? sizeof(int32_t) : sizeof(double);
+	size_t size;
+	void* p = map_file(path, size);
+	if(p == NULL)
+		return NULL;
+	if(size % element_size != 0)
+	{
+		munmap(p, size);
+		return NULL;
+	}
+	madvise(p, size, MADV_SEQUENTIAL);
+	return create_mapped_list(element_type, size / element_size, p, p, size);
+}
+
+/*
+Reads a number from the characters [p, end), allowing white space around it. Integers which fit an int32_t are
+returned as integers, other numbers as floats. Returns false if the characters are not a number.
+Decimals of up to 15 digits with an exponent of at most 22 are converted exactly by one multiplication or division of
+two doubles, which are exact themselves. Other numbers are left to strtod.
+*/
+static bool parse_number(const char* p, const char* end, object_type_t& type, int32_t& integer, double& value)
+{
+#define NUMBER_LENGTH (64)
+#define EXACT_DIGITS (15)
+#define EXACT_EXPONENT (22)
+	static const double powers[EXACT_EXPONENT + 1] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+		1e20, 1e21, 1e22
+	};
+
+	while(p < end && (*p == ' ' || *p == '\t'))
+		++p;
+	while(end > p && (end[-1] == ' ' || end[-1] == '\t'))
+		--end;
+	if(p == end)
+		return false;
+
+	//the number is read without copying it, which is the common case of sensor data.
+	const char* q = p;
+	bool negative = (*q == '-');
+	if(*q == '-' || *q == '+')
+		++q;
+	int64_t mantissa = 0;
+	int digits = 0, exponent = 0;
+	bool fraction = false;
+	for(; q < end; ++q)
+	{
+		if(*q == '.' && !fraction)
+			fraction = true;
+		else if(isdigit(*q))
+		{
+			if(digits || *q != '0')
+				++digits;
+			if(digits <= EXACT_DIGITS)
+			{
+				mantissa = mantissa * 10 + (*q - '0');
+				exponent -= fraction;
+			}
+			else if(!fraction)
+				++exponent;
+		}
+		else
+			break;
+	}
+	bool any_digits = q > p + (negative || *p == '+') + fraction;
+	if(any_digits && q < end && (*q == 'e' || *q == 'E'))
+	{
+		const char* r = q + 1;
+		bool negative_exponent = (r < end && *r == '-');
+		if(r < end && (*r == '-' || *r == '+'))
+			++r;
+		int e = 0;
+		for(; r < end && isdigit(*r) && e < 10000; ++r)
+			e = e * 10 + (*r - '0');
+		if(r > q + 1 && isdigit(r[-1]))
+		{
+			exponent += negative_exponent ? -e : e;
+			q = r;
+		}
+	}
+	if(any_digits && q == end && digits <= EXACT_DIGITS)
+	{
+		if(exponent == 0 && !fraction && mantissa <= INT32_MAX + (int64_t) negative)
+		{
+			type = OBJECT_INTEGER;
+			integer = (int32_t) (negative ? -mantissa : mantissa);
+			return true;
+		}
+		if(exponent >= -EXACT_EXPONENT && exponent <= EXACT_EXPONENT)
+		{
+			type = OBJECT_FLOAT;
+			value = (exponent < 0) ? mantissa / powers[-exponent] : mantissa * powers[exponent];
+			value = negative ? -value : value;
+			return true;
+		}
+	}
+
+	//the field is not terminated in the file, so strtod reads a copy of it.
+	char buffer[NUMBER_LENGTH];
+	if(end - p >= NUMBER_LENGTH)
+		return false;
+	memcpy(buffer, p, end - p);
+	buffer[end - p] = '\0';
+	char* r;
+	value = strtod(buffer, &r);
+	type = OBJECT_FLOAT;
+	return r != buffer && *r == '\0';
+#undef EXACT_EXPONENT
+#undef EXACT_DIGITS
+#undef NUMBER_LENGTH
+}
+
+/*
+The file is mapped and parsed in place. Fields may be quoted with "", and a first line which does not hold a number
+in the column is taken for a header. Blank lines are skipped; any other line without a number in the column fails
+the load. The column holds integers until a number which is not an int32_t is read, from then on floats.
+*/
+object* object::load_csv_column(const char* path, int column)
+{
+	size_t size;
+	const char* base = (const char*) map_file(path, size);
+	if(base == NULL || column < 0)
+	{
+		if(base)
+			munmap((void*) base, size);
+		return NULL;
+	}
+	madvise((void*) base, size, MADV_SEQUENTIAL);
+
+	object_type_t element_type = OBJECT_INTEGER;
+	size_t length = 0, capacity = 0;
+	char* elements = NULL;
+	bool first = true, failed = false;
+
+	const char* end = base + size;
+	for(const char* p = base; p < end && !failed; )
+	{
+		const char* eol = (const char*) memchr(p, '\n', end - p);
+		if(eol == NULL)
+			eol = end;
+		const char* line_end = (eol > p && eol[-1] == '\r') ? eol - 1 : eol;
+		const char* field = p;
+		p = eol + 1;
+		if(field == line_end)
+			continue;
+
+		//skip to the field, and find its end.
+		const char* field_end = NULL;
+		for(int c = 0; ; ++c)
+		{
+			const char* q = field;
+			const char* quoted_end = NULL;
+			if(q < line_end && *q == '"')
+			{
+				for(++q; q < line_end && !(*q == '"' && (q + 1 == line_end || q[1] != '"')); q += (*q == '"') ? 2 : 1)
+					;
+				quoted_end = q;
+			}
+			const char* comma = (const char*) memchr(q, ',', line_end - q);
+			if(comma == NULL)
+				comma = line_end;
+			if(c == column)
+			{
+				field_end = quoted_end ? quoted_end : comma;
+				field += quoted_end ? 1 : 0;
+				break;
+			}
+			if(comma == line_end)
+				break;
+			field = comma + 1;
+		}
+
+		object_type_t type = OBJECT_INTEGER;
+		int32_t integer = 0;
+		double value = 0;
+		if(field_end == NULL || !parse_number(field, field_end, type, integer, value))
+		{
+			failed = !first;
+			first = false;
+			continue;
+		}
+		first = false;
+
+		//the elements grow by realloc, which moves large blocks by remapping their pages.
+		if(type == OBJECT_FLOAT && element_type == OBJECT_INTEGER)
+		{
+			char* d = (char*) malloc((capacity ? capacity : 1) * sizeof(double));
+			for(size_t i = 0; d && i < length; ++i)
+				((double*) d)[i] = ((int32_t*) elements)[i];
+			free(elements);
+			elements = d;
+			element_type = OBJECT_FLOAT;
+			failed = (elements == NULL);
+		}
+		size_t element_size = (element_type == OBJECT_INTEGER) ? sizeof(int32_t) : sizeof(double);
+		if(length == capacity && !failed)
+		{
+			capacity = capacity ? capacity * 2 : 1024;
+			char* d = (char*) realloc(elements, capacity * element_size);
+			failed = (d == NULL);
+			elements = d ? d : elements;
+		}
+		if(failed)
+			break;
+		if(element_type == OBJECT_INTEGER)
+			((int32_t*) elements)[length++] = integer;
+		else
+			((double*) elements)[length++] = (type == OBJECT_INTEGER) ? integer : value;
+	}
+	munmap((void*) base, size);
+
+	if(failed)
+	{
+		free(elements);
+		return NULL;
+	}
+	size_t element_size = (element_type == OBJECT_INTEGER) ? sizeof(int32_t) : sizeof(double);
+	if(length < capacity)
+		elements = (char*) realloc(elements, (length ? length : 1) * element_size);
+	return create_mapped_list(element_type, length, elements, NULL, 0);
+}
+
+//end list processing functions.
+
+//only the refcounts of shared objects pay for atomic updates.
+void object::increment_refcount()
+{
+	if(flags & OBJECT_SHARED)
+		__sync_add_and_fetch(&refcount, 1);
+	else
+		++refcount;
+}
+
+void object::decrement_refcount()
+{
+	int n = (flags & OBJECT_SHARED) ? __sync_sub_and_fetch(&refcount, 1) : --refcount;
+	if(n == 0)
+		object_reap(this);
+}
+
+void object::share(object* o)
+{
+	//objects which are shared already may be in use by other threads.
+	if(o->flags & OBJECT_SHARED)
+		return;
+	o->flags |= OBJECT_SHARED;
+	if(o->type == OBJECT_LIST && !(o->flags & OBJECT_MAPPED))
+	{
+		object_list_pointer_t v = (object_list_pointer_t) o->handle;
+		for(int i = 0; i < v->size(); ++i)
+			share((*v)[i]);
+	}
+}
+
+void object::object_reap(object* o)
+{
+	if(o->refcount == 0)
+	{
+#ifdef DEBUG_NEO
+		printf("destroying ");
+		o->print_object(true, '\n');
+#endif
+		isolate* heap = isolate::current();
+		if(o->type == OBJECT_STRING)
+			string_text::of(o->handle)->release();
+		else if(o->type == OBJECT_LIST && (o->flags & OBJECT_MAPPED))
+			release_array((mapped_array*) o->handle);
+		else if(o->type == OBJECT_LIST)
+		{
+			//the elements of a list are owned by the list alone, and are reaped with it.
+			vector <object*> * v = (vector <object*> *) o->handle;
+			trace_span span("reap");
+			if(v)
+			{
+				span.set_arg("elements", v->size());
+				for(int i = 0; i < v->size(); ++i)
+					object_reap((*v)[i]);
+				heap->count_freed(sizeof(vector<object*>) + v->capacity() * sizeof(object*));
+			}
+			delete v;
+		}
+		heap->count_reaped(o->type);
+		delete o;
+	}
+}
+
+/*
+Renders values as text into a buffer which grows as needed. A formatter writing to a file hands the buffer to fwrite
+whenever FORMAT_FLUSH_SIZE bytes have piled up, and once more when it is destroyed; otherwise the text is kept.
+Floats are written as the shortest text which reads back as the same value, or with 2 decimals.
+*/
+class value_formatter
+{
+	public:
+		typedef enum { FLOAT_SHORTEST, FLOAT_FIXED } float_format_t;
+		//the format of floats, FLOAT_FIXED if neo is run with -d.
+		static float_format_t float_format;
+
+		value_formatter(FILE* f = NULL) : out(f), text(NULL), used(0), capacity(0) {}
+		~value_formatter() { flush(); delete [] text; }
+
+		void write(const char* s, size_t n)
+		{
+			reserve(n);
+			memcpy(text + used, s, n);
+			used += n;
+		}
+		void write(char c)
+		{
+			reserve(1);
+			text[used++] = c;
+		}
+		void write_integer(int64_t v);
+		void write_float(double v);
+		//strings are quoted and followed by their length, as the interpreter prints them, unless plain is set.
+		void write_object(const object* o, bool plain = false);
+		void flush();
+
+		const char* data() const { return text ? text : ""; }
+		size_t length() const { return used; }
+
+	private:
+#define FORMAT_FLUSH_SIZE (64 * 1024)
+		FILE* out;
+		char* text;
+		size_t used;
+		size_t capacity;
+
+		//makes room for n more bytes.
+		void reserve(size_t n);
+};
+
+value_formatter::float_format_t value_formatter::float_format = value_formatter::FLOAT_SHORTEST;
+
+void value_formatter::reserve(size_t n)
+{
+	if(out && used > 0 && used + n > FORMAT_FLUSH_SIZE)
+		flush();
+	if(used + n <= capacity)
+		return;
+	size_t c = max(max(2 * capacity, used + n), (size_t) 256);
+	char* t = new char[c];
+	if(used)
+		memcpy(t, text, used);
+	delete [] text;
+	text = t;
+	capacity = c;
+}
+
+void value_formatter::flush()
+{
+	if(out && used)
+		fwrite(text, 1, used, out);
+	if(out)
+		used = 0;
+}
+
+//two digits are converted at a time.
+void value_formatter::write_integer(int64_t v)
+{
+	static const char pairs[] =
+		"0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+		"5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+	char digits[24];
+	char* p = digits + sizeof(digits);
+	uint64_t u = (v < 0) ? 0 - (uint64_t) v : (uint64_t) v;
+	for(; u >= 100; u /= 100)
+	{
+		p -= 2;
+		memcpy(p, pairs + 2 * (u % 100), 2);
+	}
+	if(u >= 10)
+	{
+		p -= 2;
+		memcpy(p, pairs + 2 * u, 2);
+	}
+	else
+		*--p = '0' + u;
+	if(v < 0)
+		*--p = '-';
+	write(p, digits + sizeof(digits) - p);
+}
+
+void value_formatter::write_float(double v)
+{
+	//%.2f of the largest double takes 312 characters.
+	char b[320];
+	int n;
+	if(float_format == FLOAT_FIXED)
+		n = snprintf(b, sizeof(b), "%.2f", v);
+	else
+	{
+#if defined(__cpp_lib_to_chars)
+		n = std::to_chars(b, b + sizeof(b), v).ptr - b;
+#else
+		//the shortest precision whose text reads back as v.
+		for(int precision = 1; precision <= 17; ++precision)
+		{
+			n = snprintf(b, sizeof(b), "%.*g", precision, v);
+			if(strtod(b, NULL) == v)
+				break;
+		}
+#endif
+		//integral values keep a decimal point, so that they are told apart from integers.
+		bool integral = true;
+		for(int i = 0; i < n && integral; ++i)
+			integral = (b[i] == '-' || isdigit(b[i]));
+		if(integral)
+		{
+			memcpy(b + n, ".0", 2);
+			n += 2;
+		}
+	}
+	write(b, n);
+}
+
+void value_formatter::write_object(const object* o, bool plain)
+{
+	switch(o->type)
+	{
+		case OBJECT_INTEGER: write_integer(o->intvalue); break;
+		case OBJECT_FLOAT:   write_float(o->floatvalue); break;
+		case OBJECT_STRING:
+			if(plain)
+			{
+				write((const char*) o->handle, o->get_string_length());
+				break;
+			}
+			write('\'');
+			write((const char*) o->handle, o->get_string_length());
+			write("' length=", 9);
+			write_integer(o->get_string_length());
+			break;
+		case OBJECT_LIST:
+		{
+			//every element is followed by a comma, but the last one by a space.
+			size_t n = o->get_list_length();
+			write('{');
+			if(o->flags & OBJECT_MAPPED)
+			{
+				const mapped_array* a = (const mapped_array*) o->handle;
+				for(size_t i = 0; i < n; ++i)
+				{
+					if(a->element_type == OBJECT_INTEGER)
+						write_integer(((const int32_t*) a->elements)[i]);
+					else
+						write_float(((const double*) a->elements)[i]);
+					write(i == n - 1 ? ' ' : ',');
+				}
+			}
+			else
+			{
+				const vector<object*>* v = (const vector<object*>*) o->handle;
+				for(size_t i = 0; i < n; ++i)
+				{
+					write_object((*v)[i]);
+					write(i == n - 1 ? ' ' : ',');
+				}
+			}
+			write("} length=", 9);
+			write_integer(n);
+			break;
+		}
+	}
+}
+#undef FORMAT_FLUSH_SIZE
+
+//the value of o as text, strings without quotes.
+string object::debug_string(const object* o)
+{
+	value_formatter f;
+	f.write_object(o, true);
+	return string(f.data(), f.length());
+}
+
+int object::compare_strings(const object& lhs, const object& rhs, bool ordered)
+{
+	if(lhs.handle == rhs.handle)
+		return 0;
+	const string_text* l = string_text::of(lhs.handle);
+	const string_text* r = string_text::of(rhs.handle);
+	if(!ordered && ((l->interned && r->interned) || l->length != r->length))
+		return 1;
+	int c = memcmp(l->text, r->text, min(l->length, r->length));
+	return c ? c : (l->length < r->length ? -1 : (l->length > r->length ? 1 : 0));
+}
+
+void object::print_memory_stats()
+{
+	isolate::current()->print_metrics(stdout);
+	intern_table::print_stats(stdout);
+}
+
+void object::print_object(bool verbose, char tchar, FILE* out)
+{
+	value_formatter f(out);
+	if(verbose)
+	{
+		char header[128];
+		int n = snprintf(header, sizeof(header), "object@ %p type=%s reference_count=%d ", this,
+			object_type_strings[this->type], this->refcount);
+		f.write(header, n);
+	}
+	f.write_object(this);
+	f.write(tchar);
+}
+
+/*
+String kernels. Swapping the case of ASCII letters and searching for a substring run 16 or 32 bytes at a time, with
+the widest instructions the CPU supports, which are chosen once at startup. Comparing and copying strings is left to
+memcmp and memcpy, which the C library already dispatches the same way; strings are compared over their lengths,
+not up to a NUL as with strcmp.
+*/
+struct string_kernels
+{
+	const char* name;
+	//swaps the case of the letters of n bytes of src into dst.
+	void (*swap_case)(char* dst, const char* src, size_t n);
+	//returns the position of the first occurrence of needle (m bytes) in haystack (n bytes), or n if there is none.
+	size_t (*find)(const char* haystack, size_t n, const char* needle, size_t m);
+};
+
+static void swap_case_scalar(char* dst, const char* src, size_t n)
+{
+	for(size_t i = 0; i < n; ++i)
+	{
+		//c is a letter if c | 0x20 is a lowercase one, and flipping 0x20 swaps its case.
+		unsigned char c = src[i];
+		dst[i] = ((unsigned char) ((c | 0x20) - 'a') < 26) ? (c ^ 0x20) : c;
+	}
+}
+
+static size_t find_scalar(const char* haystack, size_t n, const char* needle, size_t m)
+{
+	if(m == 0)
+		return 0;
+	if(m > n)
+		return n;
+	const char* end = haystack + n - m + 1;
+	for(const char* p = haystack; (p = (const char*) memchr(p, needle[0], end - p)) != NULL; ++p)
+		if(memcmp(p + 1, needle + 1, m - 1) == 0)
+			return p - haystack;
+	return n;
+}
+
+#if defined(__x86_64__)
+//the vector kernels handle whole blocks and leave the remaining bytes to the scalar ones. a letter is found by adding
+//128 - 'a' to c | 0x20, which maps the lowercase letters to the 26 smallest signed bytes.
+#define SWAP_CASE_KERNEL(name, target, vector_t, width, load, store, set1, add, or_, and_, xor_, cmpgt) \
+target static void name(char* dst, const char* src, size_t n) \
+{ \
+	const vector_t bit = set1(0x20), shift = set1(128 - 'a'), bound = set1(-128 + 26); \
+	size_t i = 0; \
+	for(; i + width <= n; i += width) \
+	{ \
+		vector_t c = load((const vector_t*) (src + i)); \
+		vector_t letter = cmpgt(bound, add(or_(c, bit), shift)); \
+		store((vector_t*) (dst + i), xor_(c, and_(letter, bit))); \
+	} \
+	swap_case_scalar(dst + i, src + i, n - i); \
+}
+
+//candidates are the positions where both the first and the last byte of the needle match, which are then compared in
+//full.
+#define FIND_KERNEL(name, target, vector_t, width, load, set1, cmpeq, and_, movemask) \
+target static size_t name(const char* haystack, size_t n, const char* needle, size_t m) \
+{ \
+	if(m == 0) \
+		return 0; \
+	if(m > n) \
+		return n; \
+	const vector_t first = set1(needle[0]), last = set1(needle[m - 1]); \
+	size_t i = 0; \
+	for(; i + m - 1 + width <= n; i += width) \
+	{ \
+		vector_t f = load((const vector_t*) (haystack + i)); \
+		vector_t l = load((const vector_t*) (haystack + i + m - 1)); \
+		unsigned int candidates = movemask(and_(cmpeq(f, first), cmpeq(l, last))); \
+		for(; candidates != 0; candidates &= candidates - 1) \
+		{ \
+			size_t p = i + __builtin_ctz(candidates); \
+			if(memcmp(haystack + p + 1, needle + 1, m - 1) == 0) \
+				return p; \
+		} \
+	} \
+	size_t p = find_scalar(haystack + i, n - i, needle, m); \
+	return (p == n - i) ? n : i + p; \
+}
+
+SWAP_CASE_KERNEL(swap_case_sse2, , __m128i, 16, _mm_loadu_si128, _mm_storeu_si128, _mm_set1_epi8, _mm_add_epi8,
+	_mm_or_si128, _mm_and_si128, _mm_xor_si128, _mm_cmpgt_epi8)
+SWAP_CASE_KERNEL(swap_case_avx2, __attribute__((target("avx2"))), __m256i, 32, _mm256_loadu_si256,
+	_mm256_storeu_si256, _mm256_set1_epi8, _mm256_add_epi8, _mm256_or_si256, _mm256_and_si256, _mm256_xor_si256,
+	_mm256_cmpgt_epi8)
+FIND_KERNEL(find_sse2, , __m128i, 16, _mm_loadu_si128, _mm_set1_epi8, _mm_cmpeq_epi8, _mm_and_si128, _mm_movemask_epi8)
+FIND_KERNEL(find_avx2, __attribute__((target("avx2"))), __m256i, 32, _mm256_loadu_si256, _mm256_set1_epi8,
+	_mm256_cmpeq_epi8, _mm256_and_si256, _mm256_movemask_epi8)
+
+#undef FIND_KERNEL
+#undef SWAP_CASE_KERNEL
+#endif
+
+static string_kernels select_string_kernels()
+{
+	string_kernels k = { "scalar", swap_case_scalar, find_scalar };
+#if defined(__x86_64__)
+	//SSE2 is part of x86-64.
+	string_kernels sse2 = { "sse2", swap_case_sse2, find_sse2 };
+	string_kernels avx2 = { "avx2", swap_case_avx2, find_avx2 };
+	k = __builtin_cpu_supports("avx2") ? avx2 : sse2;
+#endif
+	return k;
+}
+
+static const string_kernels kernels = select_string_kernels();
+
+#define OPERATOR_FUNCTION(op) \
+object* operator op (object& lhs, object& rhs) \
+{ \
+	object* result = NULL; \
+	if(lhs.type == OBJECT_INTEGER && rhs.type == OBJECT_INTEGER) \
+	{ \
+		result = object::create_object(lhs.intvalue op rhs.intvalue); \
+	} \
+	return result; \
+}
+
+#define OPERATOR_INTEGER_FLOAT_FUNCTION(op) \
+object* operator op (object& lhs, object& rhs) \
+{ \
+	object* result = NULL; \
+	if(lhs.type == OBJECT_INTEGER && rhs.type == OBJECT_INTEGER) \
+		result = object::create_object(lhs.intvalue op rhs.intvalue); \
+	else if(#op == "+" && lhs.type == OBJECT_STRING && rhs.type == OBJECT_STRING) \
+	{ \
+		/*for efficiency, the text is written in place and handed to the private constructor.*/ \
+		size_t l = lhs.get_string_length(), r = rhs.get_string_length(); \
+		string_text* t = string_text::create(l + r); \
+		memcpy(t->text, lhs.handle, l); \
+		memcpy(t->text + l, rhs.handle, r); \
+		result = new object(t); \
+	} \
+	else if(#op == "+" && (lhs.type == OBJECT_LIST || rhs.type == OBJECT_LIST)) \
+	{ \
+		object& list  = (lhs.type == OBJECT_LIST ? lhs : rhs); \
+		object& other = (lhs.type == OBJECT_LIST ? rhs : lhs); \
+\
+		if(lhs.type == OBJECT_LIST && rhs.type == OBJECT_LIST) \
+		{ \
+			/*create a new list, from the elements of lhs and rhs lists and return the new list.*/ \
+			result = object::create_object(OBJECT_LIST); \
+			object::clone_and_add_to_list(result, &lhs); \
+			object::clone_and_add_to_list(result, &rhs); \
+		} \
+		else \
+		{ \
+			result = object::create_object(OBJECT_LIST); \
+			if(&lhs == &other) \
+			{ \
+				object::clone_and_add_to_list(result, &other); \
+				object::clone_and_add_to_list(result, &list); \
+			} \
+			else \
+			{ \
+				object::clone_and_add_to_list(result, &list); \
+				object::clone_and_add_to_list(result, &other); \
+			} \
+		} \
+	} \
+	else if((lhs.type == OBJECT_INTEGER || lhs.type == OBJECT_FLOAT) && \
+		(rhs.type == OBJECT_INTEGER || rhs.type == OBJECT_FLOAT)) \
+		result = object::create_object(lhs.object_to_double() op rhs.object_to_double()); \
+\
+	return result; \
+}
+
+//comparisons are defined for numbers and for strings, which are compared byte by byte. the result is 1 or 0.
+#define COMPARISON_FUNCTION(op) \
+object* operator op (object& lhs, object& rhs) \
+{ \
+	object* result = NULL; \
+	if(lhs.type == OBJECT_STRING && rhs.type == OBJECT_STRING) \
+		result = object::create_object((int) (object::compare_strings(lhs, rhs, #op[0] != '=') op 0)); \
+	else if((lhs.type == OBJECT_INTEGER || lhs.type == OBJECT_FLOAT) && \
+		(rhs.type == OBJECT_INTEGER || rhs.type == OBJECT_FLOAT)) \
+		result = object::create_object((int) (lhs.object_to_double() op rhs.object_to_double())); \
+\
+	return result; \
+}
+
+object* operator % (object& lhs, object& rhs)
+{
+	object* result = NULL;
+	if(lhs.type == OBJECT_INTEGER && rhs.type == OBJECT_INTEGER)
+		result = object::create_object(lhs.intvalue % rhs.intvalue);
+	//% is undefined for floating point values in C. However neo defines % analogous to how it operates for an integer.
+	else if((lhs.type == OBJECT_INTEGER || lhs.type == OBJECT_FLOAT) &&
+		(rhs.type == OBJECT_INTEGER || rhs.type == OBJECT_FLOAT))
+	{
+		double l = lhs.object_to_double(), r = rhs.object_to_double();
+		result = object::create_object(l - ((long)(l / r) * r));
+	}
+
+	return result;
+}
+
+OPERATOR_INTEGER_FLOAT_FUNCTION(+)
+OPERATOR_INTEGER_FLOAT_FUNCTION(-)
+OPERATOR_INTEGER_FLOAT_FUNCTION(*)
+OPERATOR_INTEGER_FLOAT_FUNCTION(/)
+OPERATOR_FUNCTION(&)
+OPERATOR_FUNCTION(|)
+OPERATOR_FUNCTION(^)
+COMPARISON_FUNCTION(==)
+COMPARISON_FUNCTION(<)
+COMPARISON_FUNCTION(>)
+
+#undef COMPARISON_FUNCTION
+#undef OPERATOR_INTEGER_FLOAT_FUNCTION
+#undef OPERATOR_FUNCTION
+
+//the operator ? returns the position of the first occurrence of the string rhs in the string lhs, or -1.
+object* find_string(const object& lhs, const object& rhs)
+{
+	if(lhs.get_type() != OBJECT_STRING || rhs.get_type() != OBJECT_STRING)
+		return NULL;
+	size_t n = lhs.get_string_length(), m = rhs.get_string_length();
+	size_t p = kernels.find(lhs.get_string(), n, rhs.get_string(), m);
+	return object::create_object(p == n && m != 0 ? -1 : (int) p);
+}
+
+object* operator ~ (object& rhs)
+{
+	object* result = NULL;
+	if(rhs.type == OBJECT_INTEGER)
+	{
+		result = object::create_object(~rhs.intvalue);
+	} else if(rhs.type == OBJECT_STRING)
+	{
+		size_t n = rhs.get_string_length();
+		string_text* t = string_text::create(n);
+		kernels.swap_case(t->text, (const char*) rhs.handle, n);
+		result = new object(t);
+	}
+	return result;
+}
+
+//files may be loaded by scripts run from the command line, and by preludes, but not by the sessions of a server.
+static bool loading_allowed = true;
+
+/*
+The operator @ loads a list from a file. The operand is the path of the file, whose extension tells the format:
+.i32 and .f64 files are arrays of int32_t and double values, mapped into memory; .csv files are read from their
+first column. Otherwise the operand is a list of the path and either the format ('int32' or 'float64') or the
+column of a CSV file, counting from 0. Returns NULL if the file cannot be loaded.
+*/
+object* load_list(const object& source)
+{
+	if(!loading_allowed)
+		return NULL;
+
+	const object* path = &source;
+	const object* how = NULL;
+	if(source.get_type() == OBJECT_LIST && source.get_list_length() == 2)
+	{
+		path = source.get_list_item(0);
+		how = source.get_list_item(1);
+	}
+	if(path == NULL || path->get_type() != OBJECT_STRING)
+		return NULL;
+
+	string p(path->get_string());
+	size_t dot = p.rfind('.');
+	string extension = (dot == string::npos) ? "" : p.substr(dot);
+
+	if(how == NULL && extension == ".i32")
+		return object::map_list(p.c_str(), OBJECT_INTEGER);
+	else if(how == NULL && extension == ".f64")
+		return object::map_list(p.c_str(), OBJECT_FLOAT);
+	else if(how == NULL && extension == ".csv")
+		return object::load_csv_column(p.c_str(), 0);
+	else if(how && how->get_type() == OBJECT_INTEGER)
+		return object::load_csv_column(p.c_str(), how->get_integer());
+	else if(how && how->get_type() == OBJECT_STRING && !strcmp(how->get_string(), "int32"))
+		return object::map_list(p.c_str(), OBJECT_INTEGER);
+	else if(how && how->get_type() == OBJECT_STRING && !strcmp(how->get_string(), "float64"))
+		return object::map_list(p.c_str(), OBJECT_FLOAT);
+	return NULL;
+}
+
+class token
+{
+	public:
+#define VARIABLE_NAME_LENGTH (31)
+	operator_t type;
+	union {
+		object_pointer_t objectp; 		//valid only for OP_OBJECT.
+		char varname[VARIABLE_NAME_LENGTH + 1]; //valid only for OP_VARIABLE.
+		int error_code; 			//valid only for OP_INVALID.
+	};
+
+	token() { objectp = NULL; }
+#undef VARIABLE_NAME_LENGTH
+};
+typedef token token_t;
+
+void print_token(const token_t& t, FILE* out = stdout)
+{
+	switch(t.type)
+	{
+		case OP_OBJECT:
+			fprintf(out, "token: type=%s p=%p\n", operator_strings[t.type], t.objectp);
+			break;
+		case OP_VARIABLE:
+			fprintf(out, "token: type=%s reference=%s\n", operator_strings[t.type], t.varname);
+			break;
+		case OP_INVALID:
+			fprintf(out, "token: type=%s error=%s\n", operator_strings[t.type], error_codes[t.error_code]);
+			break;
+		default:
+			fprintf(out, "token: type=%s\n", operator_strings[t.type]);
+	}
+}
+
+/*
+Snapshots of symbol tables. A snapshot is a binary image of the symbols of a table and of the objects they refer to,
+written once (from a prelude script, say) and mapped into memory by any number of processes later. All references
+within the image are offsets from its start, so the image is used in place, wherever it is mapped. Nothing is decoded
+when an image is loaded: the value of a symbol is built from the image when the symbol is first looked up (a lazy
+fix-up), and is kept for later lookups.
+
+The image consists of a header, the object records, the symbol names and the symbol table, sorted by name. Object
+records are aligned to 8 bytes and are made of a snapshot_record, followed by
+	nothing              for integers,
+	the value            for floats,
+	the characters       for strings, with a terminating NUL,
+	the element records  for lists,
+	the elements         for lists with mapped storage, whose type is SNAPSHOT_ARRAY with the type of their elements.
+*/
+#define SNAPSHOT_MAGIC "NEOSNAP"
+#define SNAPSHOT_VERSION (2)
+#define SNAPSHOT_ARRAY (0x100)
+
+struct snapshot_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t symbol_count;
+	uint64_t symbols; //offset of the symbol table.
+	uint64_t size;    //of the whole image.
+};
+
+struct snapshot_symbol
+{
+	uint64_t name;  //offset of the name, which is not NUL terminated.
+	uint32_t name_length;
+	uint32_t reserved;
+	uint64_t value; //offset of the object record.
+};
+
+struct snapshot_record
+{
+	uint32_t type;
+	union {
+		int32_t integer; //the value of an integer.
+		uint32_t length; //the length of a string, or the number of elements of a list.
+	};
+};
+
+//builds the image of a set of symbols in memory, and writes it out.
+class snapshot_writer
+{
+	public:
+		//values referred to by several symbols are written once.
+		void add_symbol(const string& name, const object* value);
+		bool write(const char* path);
+
+	private:
+		vector< char > data; //everything after the header.
+		map< const object*, uint64_t > written;
+		vector< pair< string, uint64_t > > symbols;
+
+		//appends n bytes, padded to a multiple of 8, and returns their offset in the image.
+		uint64_t append(const void* p, size_t n);
+		uint64_t add_object(const object* o);
+};
+
+uint64_t snapshot_writer::append(const void* p, size_t n)
+{
+	uint64_t offset = sizeof(snapshot_header) + data.size();
+	data.insert(data.end(), (const char*) p, (const char*) p + n);
+	data.resize((data.size() + 7) & ~(size_t) 7, 0);
+	return offset;
+}
+
+uint64_t snapshot_writer::add_object(const object* o)
+{
+	snapshot_record r;
+	r.type = o->get_type();
+	switch(o->get_type())
+	{
+		case OBJECT_INTEGER:
+			r.integer = o->get_integer();
+			return append(&r, sizeof(r));
+		case OBJECT_FLOAT:
+		{
+			r.length = 0;
+			double v = o->get_float();
+			uint64_t offset = append(&r, sizeof(r));
+			append(&v, sizeof(v));
+			return offset;
+		}
+		case OBJECT_STRING:
+		{
+			r.length = o->get_string_length();
+			uint64_t offset = append(&r, sizeof(r));
+			append(o->get_string(), r.length + 1);
+			return offset;
+		}
+		case OBJECT_LIST:
+		{
+			r.length = o->get_list_length();
+			const mapped_array* a = o->get_mapped_array();
+			if(a)
+			{
+				r.type = SNAPSHOT_ARRAY | a->element_type;
+				uint64_t offset = append(&r, sizeof(r));
+				append(a->elements, r.length * ((a->element_type == OBJECT_INTEGER) ? sizeof(int32_t) : sizeof(double)));
+				return offset;
+			}
+			uint64_t offset = append(&r, sizeof(r));
+			for(size_t i = 0; i < r.length; ++i)
+				add_object(o->get_list_item(i));
+			return offset;
+		}
+	}
+	return 0;
+}
+
+void snapshot_writer::add_symbol(const string& name, const object* value)
+{
+	map< const object*, uint64_t >::iterator i = written.find(value);
+	uint64_t offset = (i != written.end()) ? i->second : (written[value] = add_object(value));
+	symbols.push_back(make_pair(name, offset));
+}
+
+bool snapshot_writer::write(const char* path)
+{
+	sort(symbols.begin(), symbols.end());
+
+	vector< snapshot_symbol > table(symbols.size());
+	for(size_t i = 0; i < symbols.size(); ++i)
+	{
+		table[i].name = append(symbols[i].first.data(), symbols[i].first.size());
+		table[i].name_length = symbols[i].first.size();
+		table[i].reserved = 0;
+		table[i].value = symbols[i].second;
+	}
+
+	snapshot_header h;
+	memset(&h, 0, sizeof(h));
+	strcpy(h.magic, SNAPSHOT_MAGIC);
+	h.version = SNAPSHOT_VERSION;
+	h.symbol_count = table.size();
+	h.symbols = table.empty() ? sizeof(h) + data.size() : append(&table[0], table.size() * sizeof(snapshot_symbol));
+	h.size = sizeof(h) + data.size();
+
+	FILE* f = fopen(path, "wb");
+	if(f == NULL)
+		return false;
+	bool written = fwrite(&h, sizeof(h), 1, f) == 1 && (data.empty() || fwrite(&data[0], data.size(), 1, f) == 1);
+	return (fclose(f) == 0) && written;
+}
+
+/*
+A snapshot mapped into memory. Values built from the image are shared objects, which the image holds a reference to
+for as long as it exists.
+*/
+class snapshot_image
+{
+	public:
+		//maps the image in the file path. returns NULL, and sets error, if the file is not a valid snapshot.
+		static snapshot_image* open(const char* path, const char** error);
+
+		//true if the file path starts like a snapshot.
+		static bool is_snapshot(const char* path);
+		~snapshot_image();
+
+		//may be called by several threads at once.
+		bool get_symbol(const string& var, object_pointer_t& value);
+
+		uint32_t symbol_count() const { return count; }
+
+	private:
+		snapshot_image(const char* b, size_t n);
+
+		const char* base;
+		size_t size;
+		const snapshot_symbol* symbols;
+		uint32_t count;
+
+		object_pointer_t* values; //values of the symbols, NULL until they are looked up.
+		map< uint64_t, object_pointer_t > built; //values by offset, for symbols which share a value.
+		pthread_mutex_t lock;
+
+		//the values are built in an isolate of the image, rather than in that of the session which looks them up
+		//first, so that no session is charged for them.
+		isolate heap;
+
+		int find(const string& var) const;
+
+		//builds the object whose record is at offset, and moves offset past the record. returns NULL if the
+		//record is malformed.
+		object_pointer_t build(uint64_t& offset, int depth);
+};
+
+snapshot_image::snapshot_image(const char* b, size_t n) : base(b), size(n), heap(true)
+{
+	const snapshot_header* h = (const snapshot_header*) base;
+	symbols = (const snapshot_symbol*) (base + h->symbols);
+	count = h->symbol_count;
+	values = new object_pointer_t[count]();
+	pthread_mutex_init(&lock, NULL);
+}
+
+snapshot_image::~snapshot_image()
+{
+	isolate_scope scope(&heap);
+	for(map< uint64_t, object_pointer_t >::iterator i = built.begin(); i != built.end(); ++i)
+		i->second->decrement_refcount();
+	delete [] values;
+	pthread_mutex_destroy(&lock);
+	munmap((void*) base, size);
+}
+
+snapshot_image* snapshot_image::open(const char* path, const char** error)
+{
+	*error = "cannot open file";
+	int fd = ::open(path, O_RDONLY);
+	if(fd < 0)
+		return NULL;
+
+	struct stat sb;
+	void* p = MAP_FAILED;
+	if(fstat(fd, &sb) == 0 && sb.st_size >= (off_t) sizeof(snapshot_header))
+		p = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if(p == MAP_FAILED)
+		return NULL;
+
+	//the header and the symbol table are checked up front, object records when they are used.
+	const char* base = (const char*) p;
+	const snapshot_header* h = (const snapshot_header*) base;
+	size_t size = sb.st_size;
+	*error = "not a snapshot, or a snapshot of another version";
+	bool valid = !memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) && h->version == SNAPSHOT_VERSION &&
+		h->size == size && h->symbols % 8 == 0 && h->symbols <= size &&
+		(size - h->symbols) / sizeof(snapshot_symbol) >= h->symbol_count;
+	for(uint32_t i = 0; valid && i < h->symbol_count; ++i)
+	{
+		const snapshot_symbol& sym = ((const snapshot_symbol*) (base + h->symbols))[i];
+		valid = sym.name <= size && size - sym.name >= sym.name_length && sym.value % 8 == 0 &&
+			sym.value < size;
+	}
+	if(!valid)
+	{
+		munmap(p, size);
+		return NULL;
+	}
+	return new snapshot_image(base, size);
+}
+
+bool snapshot_image::is_snapshot(const char* path)
+{
+	char magic[sizeof(SNAPSHOT_MAGIC)];
+	FILE* f = fopen(path, "rb");
+	if(f == NULL)
+		return false;
+	bool found = fread(magic, sizeof(magic), 1, f) == 1 && !memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic));
+	fclose(f);
+	return found;
+}
+
+int snapshot_image::find(const string& var) const
+{
+	int low = 0, high = (int) count - 1;
+	while(low <= high)
+	{
+		int middle = low + (high - low) / 2;
+		const snapshot_symbol& sym = symbols[middle];
+		int c = var.compare(0, string::npos, base + sym.name, sym.name_length);
+		if(c == 0)
+			return middle;
+		else if(c < 0)
+			high = middle - 1;
+		else
+			low = middle + 1;
+	}
+	return -1;
+}
+
+object_pointer_t snapshot_image::build(uint64_t& offset, int depth)
+{
+#define SNAPSHOT_MAX_DEPTH (64)
+	if(depth > SNAPSHOT_MAX_DEPTH || offset > size || size - offset < sizeof(snapshot_record))
+		return NULL;
+#undef SNAPSHOT_MAX_DEPTH
+
+	const snapshot_record* r = (const snapshot_record*) (base + offset);
+	offset += sizeof(snapshot_record);
+	switch(r->type)
+	{
+		case OBJECT_INTEGER:
+			return object::create_object((int) r->integer);
+		case OBJECT_FLOAT:
+		{
+			if(size - offset < sizeof(double))
+				return NULL;
+			double v;
+			memcpy(&v, base + offset, sizeof(v));
+			offset += sizeof(v);
+			return object::create_object(v);
+		}
+		case OBJECT_STRING:
+		{
+			if(size - offset <= r->length || base[offset + r->length] != '\0')
+				return NULL;
+			object_pointer_t o = object::create_object(base + offset);
+			offset += (r->length + 1 + 7) & ~(uint64_t) 7;
+			return o;
+		}
+		case OBJECT_LIST:
+		{
+			//every element takes up at least one record, which bounds the length of a valid list.
+			if((size - offset) / sizeof(snapshot_record) < r->length)
+				return NULL;
+			object_pointer_t list = object::create_object(OBJECT_LIST);
+			object::reserve_list(list, r->length);
+			for(uint32_t i = 0; i < r->length; ++i)
+			{
+				object_pointer_t element = build(offset, depth + 1);
+				if(element == NULL)
+				{
+					object::object_reap(list);
+					return NULL;
+				}
+				object::add_object_to_list(list, element);
+			}
+			return list;
+		}
+		case SNAPSHOT_ARRAY | OBJECT_INTEGER:
+		case SNAPSHOT_ARRAY | OBJECT_FLOAT:
+		{
+			object_type_t element_type = (object_type_t) (r->type & ~SNAPSHOT_ARRAY);
+			uint64_t n = (uint64_t) r->length * ((element_type == OBJECT_INTEGER) ? sizeof(int32_t) : sizeof(double));
+			if(size - offset < n)
+				return NULL;
+			object_pointer_t list = object::create_array_list(element_type, r->length, base + offset);
+			offset += (n + 7) & ~(uint64_t) 7;
+			return list;
+		}
+	}
+	return NULL;
+}
+
+bool snapshot_image::get_symbol(const string& var, object_pointer_t& value)
+{
+	int i = find(var);
+	if(i < 0)
+		return false;
+
+	object_pointer_t v = __atomic_load_n(&values[i], __ATOMIC_ACQUIRE);
+	if(v == NULL)
+	{
+		pthread_mutex_lock(&lock);
+		v = values[i];
+		if(v == NULL)
+		{
+			uint64_t offset = symbols[i].value;
+			map< uint64_t, object_pointer_t >::iterator b = built.find(offset);
+			if(b != built.end())
+				v = b->second;
+			else
+			{
+				isolate_scope scope(&heap);
+				if((v = build(offset, 0)) != NULL)
+				{
+					object::share(v);
+					v->increment_refcount();
+					built[symbols[i].value] = v;
+				}
+			}
+			if(v)
+				__atomic_store_n(&values[i], v, __ATOMIC_RELEASE);
+		}
+		pthread_mutex_unlock(&lock);
+		if(v == NULL)
+			return false;
+	}
+	value = v;
+	return true;
+}
+
+#undef SNAPSHOT_ARRAY
+#undef SNAPSHOT_VERSION
+#undef SNAPSHOT_MAGIC
+
+class global_symboltable;
+
+/*
+The symbol table of a session. It may be layered over a snapshot and over the global symbol table: symbols not
+defined in the session are looked up in the snapshot, then in the global table, while assignments always define
+symbols of the session.
+*/
+void release_postfix(vector< token_t >& v);
+class result_cache;
+
+class symboltable
+{
+	public:
+		symboltable() : global(NULL), image(NULL), cache(NULL), clock(0) {}
+		~symboltable();
+
+		bool get_symbol(const string& var, object_pointer_t& value);
+		void set_symbol(const string& var, object_pointer_t value);
+
+		//looks up symbols of the session only.
+		bool get_local_symbol(const string& var, object_pointer_t& value);
+
+		void attach_global(global_symboltable* g) { global = g; }
+		global_symboltable* get_global() const { return global; }
+
+		//the image is owned by the caller, and must outlive the table.
+		void attach_image(snapshot_image* i);
+
+		//creates an undefined entry for var, so that later assignments to it do not modify the structure of
+		//the table. this lets independent statements assign distinct variables concurrently.
+		void reserve_symbol(const string& var);
+
+		//removes all symbols, releasing their values, and the entries of the cache.
+		void clear();
+
+		/*
+		Binds var to an expression (in postfix, whose constants the table takes over), replacing its value. The
+		variables read by the expression are its inputs. Assigning to an input marks var, and the variables bound
+		to expressions reading var in turn, as dirty; a dirty variable is evaluated again when it is read, as is
+		every bound variable once the global table publishes. The expression is evaluated right away. Returns
+		false, with error set to ERROR_CIRCULAR_BINDING if the expression reads var, directly or through other
+		bound variables, or to the error of the evaluation if it fails; neither the binding nor the value of var
+		change then. Assigning a value to var removes the binding.
+		*/
+		bool bind_symbol(const string& var, vector< token_t >& postfix, int& error);
+
+		//adds the bound variables, and their inputs, to bound.
+		void get_bindings(map< string, set< string > >& bound) const;
+
+		//evaluates the dirty variables, so that all values of the table are current.
+		void refresh();
+
+		//caches the results of up to entries expressions evaluated with the table, see result_cache. 0 disables
+		//the cache.
+		void enable_cache(size_t entries);
+		result_cache* get_cache() const { return cache; }
+
+		//a stamp of the value of var, which changes whenever the value may have changed.
+		uint64_t version(const string& var);
+
+		void print_all_symbols();
+	private:
+		map < string, object_pointer_t > st;
+		global_symboltable* global;
+		snapshot_image* image;
+
+		struct binding
+		{
+			vector< token_t > postfix;
+			set< string > inputs;
+			bool dirty;
+			unsigned long generation; //of the global table when the expression was last evaluated.
+		};
+		map< string, binding* > bindings;
+		map< string, set< string > > dependents; //bound variables reading each variable.
+
+		result_cache* cache;
+		uint64_t clock;
+		map< string, uint64_t > versions; //of the variables assigned while the cache is enabled.
+		void changed(const string& var) { if(cache) versions[var] = ++clock; }
+
+		void unbind_symbol(const string& var);
+		void invalidate(const string& var);
+		bool reads_symbol(const string& from, const string& var, set< string >& visited) const;
+		bool stale(const binding& b) const;
+		bool recompute(const string& var, binding& b, int* error = NULL);
+
+		friend class global_symboltable;
+		friend bool write_snapshot(symboltable& st, const char* path);
+};
+
+bool symboltable::get_local_symbol(const string& var, object_pointer_t& value)
+{
+	map < string, object_pointer_t > :: iterator i = st.find(var);
+	if(i == st.end() || (*i).second == NULL)
+		return false;
+	else
+	{
+		value = (*i).second;
+		return true;
+	}
+}
+
+void symboltable::set_symbol(const string& var, object_pointer_t value)
+{
+	st[var] = value;
+	changed(var);
+	if(!bindings.empty())
+	{
+		unbind_symbol(var);
+		invalidate(var);
+	}
+}
+
+//values are released by clear; the expressions of bindings belong to the table alone.
+symboltable::~symboltable()
+{
+	while(!bindings.empty())
+		unbind_symbol((*bindings.begin()).first);
+	if(cache)
+		enable_cache(0);
+}
+
+void symboltable::unbind_symbol(const string& var)
+{
+	map< string, binding* >::iterator b = bindings.find(var);
+	if(b == bindings.end())
+		return;
+
+	binding* old = (*b).second;
+	for(set< string >::iterator i = old->inputs.begin(); i != old->inputs.end(); ++i)
+	{
+		map< string, set< string > >::iterator d = dependents.find(*i);
+		(*d).second.erase(var);
+		if((*d).second.empty())
+			dependents.erase(d);
+	}
+	release_postfix(old->postfix);
+	delete old;
+	bindings.erase(b);
+}
+
+//a variable is dirty only if every variable reading it is dirty too, which ends the walk early.
+void symboltable::invalidate(const string& var)
+{
+	map< string, set< string > >::iterator d = dependents.find(var);
+	if(d == dependents.end())
+		return;
+	for(set< string >::iterator i = (*d).second.begin(); i != (*d).second.end(); ++i)
+	{
+		binding* b = bindings[*i];
+		if(!b->dirty)
+		{
+			b->dirty = true;
+			invalidate(*i);
+		}
+	}
+}
+
+bool symboltable::reads_symbol(const string& from, const string& var, set< string >& visited) const
+{
+	if(from == var)
+		return true;
+	map< string, binding* >::const_iterator b = bindings.find(from);
+	if(b == bindings.end() || !visited.insert(from).second)
+		return false;
+	for(set< string >::const_iterator i = (*b).second->inputs.begin(); i != (*b).second->inputs.end(); ++i)
+		if(reads_symbol(*i, var, visited))
+			return true;
+	return false;
+}
+
+bool symboltable::bind_symbol(const string& var, vector< token_t >& postfix, int& error)
+{
+	binding* b = new binding();
+	for(int i = 0; i < postfix.size(); ++i)
+		if(postfix[i].type == OP_VARIABLE)
+			b->inputs.insert(postfix[i].varname);
+
+	set< string > visited;
+	for(set< string >::iterator i = b->inputs.begin(); i != b->inputs.end(); ++i)
+	{
+		if(reads_symbol(*i, var, visited))
+		{
+			delete b;
+			error = ERROR_CIRCULAR_BINDING;
+			return false;
+		}
+	}
+
+	//the expression does not read var, so it is evaluated before the binding is made.
+	error = ERROR_UNDEFINED_VARIABLE;
+	b->postfix.swap(postfix);
+	if(!recompute(var, *b, &error))
+	{
+		b->postfix.swap(postfix);
+		delete b;
+		return false;
+	}
+
+	unbind_symbol(var);
+	invalidate(var);
+	bindings[var] = b;
+	for(set< string >::iterator i = b->inputs.begin(); i != b->inputs.end(); ++i)
+		dependents[*i].insert(var);
+	return true;
+}
+
+void symboltable::get_bindings(map< string, set< string > >& bound) const
+{
+	for(map< string, binding* >::const_iterator b = bindings.begin(); b != bindings.end(); ++b)
+		bound[(*b).first] = (*b).second->inputs;
+}
+
+void symboltable::refresh()
+{
+	object_pointer_t value;
+	for(map< string, binding* >::iterator b = bindings.begin(); b != bindings.end(); ++b)
+		if(stale(*(*b).second))
+			get_symbol((*b).first, value);
+}
+
+void symboltable::reserve_symbol(const string& var)
+{
+	if(st.find(var) == st.end())
+		st[var] = NULL;
+}
+
+void symboltable::print_all_symbols()
+{
+	map < string, object_pointer_t > :: iterator i = st.begin(), j = st.end();	
+
+	printf("symbol table <begin>\n");
+	while(i != j)
+	{
+		printf("%s = %p\n", (*i).first.c_str(), (*i).second);
+		++i;
+	}
+	printf("symbol Table <end>\n");
+}
+
+/*
+The global symbol table holds symbols shared by all sessions, such as constants and reference data. It is read
+without locks: lookups go to an immutable snapshot of the table, published through an atomic pointer. Writers
+(serialized by a mutex) copy the snapshot, modify the copy and publish it, which makes writes expensive and reads
+cheap.
+A snapshot replaced by a writer, and the values it was the last to reference, are reclaimed once every reader that
+could still be looking at it has left its read section (epoch based reclamation). Values in the global table are
+shared objects, and must not be modified.
+*/
+class global_symboltable
+{
+	public:
+		global_symboltable();
+		~global_symboltable();
+
+		//must be called within a read section.
+		bool get_symbol(const string& var, object_pointer_t& value) const;
+
+		void set_symbol(const string& var, object_pointer_t value);
+
+		//moves all symbols of source to the global table, publishing them at once.
+		void publish(symboltable& source);
+
+		//makes the symbols of a snapshot global, beneath those of the table. the image is never released.
+		void attach_image(snapshot_image* i)
+		{
+			__atomic_store_n(&image, i, __ATOMIC_RELEASE);
+			__sync_add_and_fetch(&epoch, 1);
+		}
+
+		//changes whenever a symbol of the table changes.
+		unsigned long generation() const { return __atomic_load_n(&epoch, __ATOMIC_ACQUIRE); }
+
+		//read sections may be nested.
+		void enter_read_section();
+		void leave_read_section();
+
+	private:
+		typedef map < string, object_pointer_t > snapshot_t;
+
+		//every thread which reads the table owns a reader slot, which is reused once the thread exits.
+		struct reader_slot
+		{
+			unsigned long epoch; //epoch at which the thread entered its read section, 0 if outside.
+			int nesting;
+			int in_use;
+			reader_slot* next;
+		};
+
+		//a snapshot and the values removed with it, waiting for the readers of epochs before 'epoch' to leave.
+		struct retired_snapshot
+		{
+			unsigned long epoch;
+			snapshot_t* snapshot;
+			vector< object_pointer_t > values;
+		};
+
+		snapshot_t* current;
+		snapshot_image* image;
+		unsigned long epoch;
+		reader_slot* readers;
+		pthread_key_t slot_key;
+
+		pthread_mutex_t write_lock;
+		vector< retired_snapshot > retired;
+
+		reader_slot* get_reader_slot();
+		static void release_reader_slot(void* slot);
+
+		//must be called with write_lock held.
+		void replace_snapshot(snapshot_t* next, vector< object_pointer_t >& values);
+		void reclaim();
+};
+
+global_symboltable::global_symboltable() : current(new snapshot_t()), image(NULL), epoch(1), readers(NULL)
+{
+	pthread_key_create(&slot_key, global_symboltable::release_reader_slot);
+	pthread_mutex_init(&write_lock, NULL);
+}
+
+global_symboltable::~global_symboltable()
+{
+	//the process is exiting, the remaining snapshots are simply dropped.
+	pthread_mutex_destroy(&write_lock);
+}
+
+global_symboltable::reader_slot* global_symboltable::get_reader_slot()
+{
+	reader_slot* slot = (reader_slot*) pthread_getspecific(slot_key);
+	if(slot)
+		return slot;
+
+	for(slot = __atomic_load_n(&readers, __ATOMIC_ACQUIRE); slot; slot = slot->next)
+		if(!__atomic_load_n(&slot->in_use, __ATOMIC_RELAXED) && __sync_bool_compare_and_swap(&slot->in_use, 0, 1))
+			break;
+
+	if(slot == NULL)
+	{
+		slot = new reader_slot();
+		slot->epoch = 0;
+		slot->nesting = 0;
+		slot->in_use = 1;
+		do
+		{
+			slot->next = readers;
+		} while(!__sync_bool_compare_and_swap(&readers, slot->next, slot));
+	}
+	pthread_setspecific(slot_key, slot);
+	return slot;
+}
+
+void global_symboltable::release_reader_slot(void* slot)
+{
+	__sync_lock_release(&((reader_slot*) slot)->in_use);
+}
+
+void global_symboltable::enter_read_section()
+{
+	reader_slot* slot = get_reader_slot();
+	//the epoch has to be visible to writers before the snapshot pointer is read.
+	if(slot->nesting++ == 0)
+		__atomic_store_n(&slot->epoch, __atomic_load_n(&epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+}
+
+void global_symboltable::leave_read_section()
+{
+	reader_slot* slot = get_reader_slot();
+	if(--slot->nesting == 0)
+		__atomic_store_n(&slot->epoch, 0, __ATOMIC_RELEASE);
+}
+
+bool global_symboltable::get_symbol(const string& var, object_pointer_t& value) const
+{
+	const snapshot_t* snapshot = __atomic_load_n(&current, __ATOMIC_ACQUIRE);
+	snapshot_t::const_iterator i = snapshot->find(var);
+	if(i != snapshot->end())
+	{
+		value = (*i).second;
+		return true;
+	}
+	snapshot_image* attached = __atomic_load_n(&image, __ATOMIC_ACQUIRE);
+	return attached && attached->get_symbol(var, value);
+}
+
+void global_symboltable::replace_snapshot(snapshot_t* next, vector< object_pointer_t >& values)
+{
+	retired_snapshot r;
+	r.snapshot = current;
+	r.values.swap(values);
+
+	__atomic_store_n(&current, next, __ATOMIC_SEQ_CST);
+	//readers entering from now on can only see the new snapshot.
+	r.epoch = __sync_add_and_fetch(&epoch, 1);
+	retired.push_back(r);
+
+	reclaim();
+}
+
+void global_symboltable::reclaim()
+{
+	unsigned long oldest = __atomic_load_n(&epoch, __ATOMIC_SEQ_CST);
+	for(reader_slot* slot = __atomic_load_n(&readers, __ATOMIC_ACQUIRE); slot; slot = slot->next)
+	{
+		unsigned long e = __atomic_load_n(&slot->epoch, __ATOMIC_SEQ_CST);
+		if(e != 0 && e < oldest)
+			oldest = e;
+	}
+
+	int k = 0;
+	for(int i = 0; i < retired.size(); ++i)
+	{
+		if(retired[i].epoch <= oldest)
+		{
+			delete retired[i].snapshot;
+			for(int j = 0; j < retired[i].values.size(); ++j)
+				retired[i].values[j]->decrement_refcount();
+		}
+		else
+			retired[k++] = retired[i];
+	}
+	retired.resize(k);
+}
+
+void global_symboltable::set_symbol(const string& var, object_pointer_t value)
+{
+	object::share(value);
+	value->increment_refcount();
+
+	pthread_mutex_lock(&write_lock);
+	snapshot_t* next = new snapshot_t(*current);
+	vector< object_pointer_t > replaced;
+
+	object_pointer_t& entry = (*next)[var];
+	if(entry)
+		replaced.push_back(entry);
+	entry = value;
+
+	replace_snapshot(next, replaced);
+	pthread_mutex_unlock(&write_lock);
+}
+
+void global_symboltable::publish(symboltable& source)
+{
+	//bound variables are published with their current values, as plain variables.
+	source.refresh();
+	pthread_mutex_lock(&write_lock);
+	snapshot_t* next = new snapshot_t(*current);
+	vector< object_pointer_t > replaced;
+
+	//the references held by source are handed over to the global table.
+	map < string, object_pointer_t > :: iterator i;
+	for(i = source.st.begin(); i != source.st.end(); ++i)
+	{
+		if((*i).second == NULL)
+			continue;
+		object::share((*i).second);
+
+		object_pointer_t& entry = (*next)[(*i).first];
+		if(entry)
+			replaced.push_back(entry);
+		entry = (*i).second;
+	}
+	source.st.clear();
+	source.clear();
+
+	replace_snapshot(next, replaced);
+	pthread_mutex_unlock(&write_lock);
+}
+
+//the process wide global symbol table.
+global_symboltable globals;
+
+//enters a read section of the global table of a symbol table, if it has one, for the lifetime of the scope.
+class global_read_section
+{
+	public:
+		global_read_section(const symboltable& st) : global(st.get_global())
+		{
+			if(global) global->enter_read_section();
+		}
+		~global_read_section()
+		{
+			if(global) global->leave_read_section();
+		}
+	private:
+		global_symboltable* global;
+};
+
+bool symboltable::get_symbol(const string& var, object_pointer_t& value)
+{
+	if(!bindings.empty())
+	{
+		map< string, binding* >::iterator b = bindings.find(var);
+		if(b != bindings.end() && stale(*(*b).second) && !recompute(var, *(*b).second))
+			return false;
+	}
+	return get_local_symbol(var, value) || (image && image->get_symbol(var, value)) ||
+		(global && global->get_symbol(var, value));
+}
+
+//writes the symbols of the session (not those of its snapshot or of the global table) as a snapshot.
+bool write_snapshot(symboltable& st, const char* path)
+{
+	snapshot_writer w;
+	st.refresh();
+	map < string, object_pointer_t > :: iterator i;
+	for(i = st.st.begin(); i != st.st.end(); ++i)
+		if((*i).second)
+			w.add_symbol((*i).first, (*i).second);
+	return w.write(path);
+}
+
+/*
+A cache of the results of expressions, for sessions which evaluate the same expressions over the same values again
+and again. An entry is keyed by the compiled expression (its operators, variables and constants), and holds the
+versions of the variables the expression read. It is used as long as the variables have the same versions.
+Only pure expressions are cached: those which do not assign, bind or load, and which evaluate at least one operator.
+The cache holds a bounded number of entries, and evicts the least recently used one.
+*/
+class result_cache
+{
+	public:
+		result_cache(size_t entries) : capacity(entries), hits(0), misses(0), evictions(0), uncached(0) {}
+		~result_cache() { clear(); }
+
+		//the variables read by an expression, with their versions.
+		typedef vector< pair< string, uint64_t > > input_versions;
+
+		//sets key to the key of v, and inputs to the versions of the variables v reads, as of before v is
+		//evaluated. returns false if v is not to be cached.
+		bool make_key(const vector< token_t >& v, symboltable& st, string& key, input_versions& inputs);
+
+		//returns the result cached for key, or NULL.
+		object_pointer_t lookup(const string& key, symboltable& st);
+
+		//caches the result of the expression of key, which the cache holds a reference to. an input assigned
+		//while the expression was evaluated has a newer version than inputs, which leaves the entry stale.
+		void insert(const string& key, const input_versions& inputs, object_pointer_t result);
+
+		void clear();
+
+		size_t get_capacity() const { return capacity; }
+		void print_stats(FILE* out) const;
+		string stats_json() const;
+
+	private:
+#define CACHE_KEY_LIMIT (4096) //bytes of the longest key; expressions with large constants are not worth caching.
+		struct entry
+		{
+			string key;
+			input_versions inputs;
+			object_pointer_t result;
+		};
+		list< entry > entries; //the most recently used first.
+		map< string, list< entry >::iterator > index;
+		size_t capacity;
+
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		uint64_t uncached;
+
+		static void append_object(string& key, const object* o);
+		void evict(list< entry >::iterator i);
+};
+
+void result_cache::append_object(string& key, const object* o)
+{
+	key += (char) o->get_type();
+	switch(o->get_type())
+	{
+		case OBJECT_INTEGER:
+		{
+			int v = o->get_integer();
+			key.append((const char*) &v, sizeof(v));
+			break;
+		}
+		case OBJECT_FLOAT:
+		{
+			double v = o->get_float();
+			key.append((const char*) &v, sizeof(v));
+			break;
+		}
+		case OBJECT_STRING:
+			key.append(o->get_string(), o->get_string_length() + 1);
+			break;
+		case OBJECT_LIST:
+		{
+			//the elements of mapped storage are keyed like the objects they stand for.
+			size_t n = o->get_list_length();
+			const mapped_array* a = o->get_mapped_array();
+			key.append((const char*) &n, sizeof(n));
+			for(size_t i = 0; i < n && key.size() <= CACHE_KEY_LIMIT; ++i)
+			{
+				if(a == NULL)
+					append_object(key, o->get_list_item(i));
+				else if(a->element_type == OBJECT_INTEGER)
+				{
+					int v = ((const int32_t*) a->elements)[i];
+					key += (char) OBJECT_INTEGER;
+					key.append((const char*) &v, sizeof(v));
+				}
+				else
+				{
+					key += (char) OBJECT_FLOAT;
+					key.append((const char*) &((const double*) a->elements)[i], sizeof(double));
+				}
+			}
+			break;
+		}
+	}
+}
+
+bool result_cache::make_key(const vector< token_t >& v, symboltable& st, string& key, input_versions& inputs)
+{
+	bool pure = true, evaluates = false;
+	key.clear();
+	inputs.clear();
+	for(int i = 0; pure && i < v.size() && key.size() <= CACHE_KEY_LIMIT; ++i)
+	{
+		const token_t& t = v[i];
+		pure = (t.type != OP_ASSIGN && t.type != OP_BIND && t.type != OP_LOAD);
+		evaluates = evaluates || is_evaluation_operator(t.type);
+		key += (char) t.type;
+		if(t.type == OP_VARIABLE)
+			key.append(t.varname, strlen(t.varname) + 1);
+		else if(t.type == OP_OBJECT)
+			append_object(key, t.objectp);
+	}
+	if(pure && evaluates && key.size() <= CACHE_KEY_LIMIT)
+	{
+		set< string > read;
+		for(int k = 0; k < v.size(); ++k)
+			if(v[k].type == OP_VARIABLE && read.insert(v[k].varname).second)
+				inputs.push_back(make_pair(string(v[k].varname), st.version(v[k].varname)));
+		return true;
+	}
+	++uncached;
+	return false;
+}
+
+object_pointer_t result_cache::lookup(const string& key, symboltable& st)
+{
+	map< string, list< entry >::iterator >::iterator i = index.find(key);
+	if(i != index.end())
+	{
+		list< entry >::iterator e = (*i).second;
+		bool current = true;
+		for(int k = 0; current && k < (*e).inputs.size(); ++k)
+			current = (st.version((*e).inputs[k].first) == (*e).inputs[k].second);
+		if(current)
+		{
+			++hits;
+			entries.splice(entries.begin(), entries, e);
+			return (*e).result;
+		}
+		evict(e);
+	}
+	++misses;
+	return NULL;
+}
+
+void result_cache::insert(const string& key, const input_versions& inputs, object_pointer_t result)
+{
+	map< string, list< entry >::iterator >::iterator i = index.find(key);
+	if(i != index.end())
+		evict((*i).second);
+
+	entries.push_front(entry());
+	entry& e = entries.front();
+	e.key = key;
+	e.result = result;
+	result->increment_refcount();
+	e.inputs = inputs;
+	index[key] = entries.begin();
+
+	while(entries.size() > capacity)
+	{
+		evict(--entries.end());
+		++evictions;
+	}
+}
+
+void result_cache::evict(list< entry >::iterator i)
+{
+	index.erase((*i).key);
+	(*i).result->decrement_refcount();
+	entries.erase(i);
+}
+
+void result_cache::clear()
+{
+	while(!entries.empty())
+		evict(entries.begin());
+}
+
+void result_cache::print_stats(FILE* out) const
+{
+	uint64_t lookups = hits + misses;
+	fprintf(out, "cache entries=%lu capacity=%lu hits=%llu misses=%llu hit_rate=%.2f evictions=%llu uncached=%llu\n",
+		(unsigned long) entries.size(), (unsigned long) capacity, (unsigned long long) hits,
+		(unsigned long long) misses, lookups ? (double) hits / lookups : 0.0, (unsigned long long) evictions,
+		(unsigned long long) uncached);
+}
+
+string result_cache::stats_json() const
+{
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer), "{\"entries\": %lu, \"capacity\": %lu, \"hits\": %llu, \"misses\": %llu, "
+		"\"evictions\": %llu, \"uncached\": %llu}", (unsigned long) entries.size(), (unsigned long) capacity,
+		(unsigned long long) hits, (unsigned long long) misses, (unsigned long long) evictions,
+		(unsigned long long) uncached);
+	return buffer;
+}
+#undef CACHE_KEY_LIMIT
+
+void symboltable::enable_cache(size_t entries)
+{
+	delete cache;
+	cache = entries ? new result_cache(entries) : NULL;
+	versions.clear();
+}
+
+void symboltable::clear()
+{
+	map < string, object_pointer_t > :: iterator i;
+	for(i = st.begin(); i != st.end(); ++i)
+		if((*i).second)
+			(*i).second->decrement_refcount();
+	st.clear();
+
+	while(!bindings.empty())
+		unbind_symbol((*bindings.begin()).first);
+	//the cache keeps its capacity, which the embedder chose.
+	if(cache)
+		cache->clear();
+	versions.clear();
+}
+
+void symboltable::attach_image(snapshot_image* i)
+{
+	image = i;
+	if(cache)
+		cache->clear();
+}
+
+//local versions are even, those of symbols looked up further on odd, so that the two never match. a dirty bound
+//variable is going to change once it is read, so it gets a version which matches nothing.
+uint64_t symboltable::version(const string& var)
+{
+	map< string, binding* >::iterator b = bindings.find(var);
+	if(b != bindings.end() && stale(*(*b).second))
+		return ++clock << 1;
+
+	map < string, object_pointer_t > :: iterator i = st.find(var);
+	if(i != st.end() && (*i).second)
+	{
+		map< string, uint64_t >::iterator v = versions.find(var);
+		return (v == versions.end()) ? 0 : (*v).second << 1;
+	}
+	return global ? (global->generation() << 1) | 1 : 1;
+}
+
+/*
+Read one token from istream and populate the token structure pointed by t.
+Advance and return the incoming pointer so that it points to the next token in the stream.
+*/
+const char* get_next_token(const char* istream, token_t* t)
+{
+	trace_span span("get_next_token");
+	if(istream == NULL) return NULL;
+	t->type = OP_EOF;
+
+	//Skip white space.
+	while(*istream != '\0' && (*istream == ' ' || *istream == '\n' || *istream == '\t'))
+		++istream;
+	if(*istream == '\0') return NULL;
+
+	t->type = OP_INVALID;
+	t->error_code = ERROR_PARSING_ERROR;
+
+	//Look for operators.
+	switch(*istream)
+	{
+		case '+' : t->type = OP_ADD; break;
+		case '-' : t->type = OP_SUBTRACT; break;
+		case '*' : t->type = OP_MULTIPLY; break;
+		case '/' : t->type = OP_DIVIDE; break;
+		case '%' : t->type = OP_MODULO; break;	
+		case '=' :
+			t->type = OP_ASSIGN;
+			if(istream[1] == '=')
+			{
+				t->type = OP_EQUAL;
+				++istream;
+			}
+			break;
+		case '&' : t->type = OP_BITWISE_AND; break;
+		case '|' : t->type = OP_BITWISE_OR; break;
+		case '^' : t->type = OP_BITWISE_XOR; break;
+		case '~' : t->type = OP_BITWISE_NOT; break;
+		case '@' : t->type = OP_LOAD; break;
+		case '<' : t->type = OP_LESS; break;
+		case '>' : t->type = OP_GREATER; break;
+		case '?' : t->type = OP_FIND; break;
+		case ':' :
+			if(istream[1] == '=')
+			{
+				t->type = OP_BIND;
+				++istream;
+			}
+			break;
+		case '(' : t->type = OP_OPEN_SCOPE; break;
+		case ')' : t->type = OP_CLOSE_SCOPE; break;
+		case '{' : t->type = OP_OPEN_BRACE; break;
+		case '}' : t->type = OP_CLOSE_BRACE; break;
+		case ',' : t->type = OP_SEPARATOR; break;
+	}
+
+	//Look for an integer literal.
+	if(isdigit(*istream) || (*istream == '-' && isdigit(istream[1])))
+	{
+		char * r = NULL;
+		double v = strtod(istream, &r);
+		int v_int = (int) v;
+
+		t->type = OP_OBJECT;
+		if(v - v_int == 0)
+			t->objectp = object::create_object(v_int);
+		else
+			t->objectp = object::create_object(v);
+
+		if(r == istream)
+			istream = istream + strlen(istream); 
+		else
+			istream = --r;
+	}
+
+	//Look for a string literal (enclosed in '').
+	if(*istream == '\'')
+	{
+		const char* r = istream + 1;
+		while(*r != '\0' && *r != '\'')
+			++r;
+		if(*r == '\0')
+			goto skip_reading_literal;
+		else
+		{
+			t->type = OP_OBJECT;
+			t->objectp = object::create_interned(istream + 1, r - istream - 1);
+			istream = r;
+		}
+	}
+	
+skip_reading_literal:
+	//Look for a variable name
+	if(*istream >= 'a' && *istream <= 'z')
+	{
 		const char* r = istream;
 		int i = 0;
 		t->type = OP_VARIABLE;
 		while(*r >= 'a' && *r <= 'z' && *r != '\0')
 		{
-			t->varname[i++] = *r;
-			r++;
+			t->varname[i++] = *r;
+			r++;
+		}
+		t->varname[i] = '\0';
+		istream = --r;
+	}
+	
+	//Consume exactly one token from istream and return a pointer from where the next token starts.
+	return ++istream;
+}
+
+/*
+A token_reader supplies the tokens of one expression at a time to compile_infix. OP_EOF marks the end of the
+expression.
+*/
+class token_reader
+{
+	public:
+		token_reader() : input_wait(0) {}
+		virtual ~token_reader() {}
+		virtual void next_token(token_t* t) = 0;
+
+		//nanoseconds spent waiting for input, which are not part of the latency of tokenizing.
+		uint64_t input_wait;
+
+		//predicts the length of the list literal being read, from the n elements read so far. the reader is asked
+		//again once the list reaches the predicted length.
+		virtual size_t list_size_hint(size_t n) { return n; }
+};
+
+//number of elements of a list literal after which the reader is first asked for the length of the list.
+#define LIST_SIZE_HINT_SAMPLE (4096)
+
+//reads tokens from an in-memory string.
+class string_reader : public token_reader
+{
+	public:
+		string_reader(const char* s) : p(s) {}
+
+		void next_token(token_t* t)
+		{
+			t->type = OP_EOF;
+			p = get_next_token(p, t);
+		}
+	private:
+		const char* p;
+};
+
+/*
+Reads tokens from a file (or stdin) in chunks, so that inputs of any size can be parsed without holding the whole
+source text. Every line holds one expression, except within a list literal where newlines are plain white space.
+*/
+class stream_reader : public token_reader
+{
+	public:
+		stream_reader(FILE* f);
+		~stream_reader() { delete [] buffer; }
+
+		void next_token(token_t* t);
+		size_t list_size_hint(size_t n);
+
+		//true when the stream has been consumed completely.
+		bool at_end();
+
+		//consumes the line if it consists of the command cmd alone.
+		bool read_command(const char* cmd);
+
+		//discards the rest of the current expression, if it was not read completely.
+		void end_expression();
+
+		//progress counters.
+		size_t bytes_consumed;
+		size_t tokens_read;
+		size_t list_elements;
+
+		//line of the first token of the current expression, counting from 1. it becomes the line of the thread
+		//for the profiler.
+		uint32_t expression_line;
+
+		//report progress on stderr while reading large list literals.
+		bool report_progress;
+
+	private:
+#define STREAM_CHUNK_SIZE (64 * 1024)
+#define STREAM_LOOKAHEAD (4 * 1024) //no token is longer than this, unless it runs to the end of the line or is a string.
+#define STREAM_PROGRESS_INTERVAL (1024 * 1024)
+		FILE* file;
+		char* buffer;
+		size_t capacity;   //of the buffer, which grows to hold a string literal longer than a chunk.
+		size_t begin, end; //unconsumed part of the buffer.
+		size_t newline;    //position of a newline at or after begin, if newline_found.
+		size_t scanned;    //the buffer has been searched for newlines up to this position.
+		size_t quote_scanned; //the string literal at begin has no closing quote up to this position.
+		bool newline_found;
+		bool eof;
+		bool expression_start;
+		int depth; //nesting level of list literals.
+
+		size_t file_size; //size of the input if it is a regular file, 0 otherwise.
+		size_t list_start; //bytes consumed when the current list literal was opened.
+
+		uint32_t lines; //newlines consumed.
+
+		bool fill();
+		bool token_complete();
+		void consume(size_t n);
+};
+
+void stream_reader::consume(size_t n)
+{
+	const char* p = buffer + begin, *q = p + n;
+	while((p = (const char*) memchr(p, '\n', q - p)) != NULL)
+	{
+		++lines;
+		++p;
+	}
+	begin += n;
+	bytes_consumed += n;
+}
+
+stream_reader::stream_reader(FILE* f) : bytes_consumed(0), tokens_read(0), list_elements(0), expression_line(0),
+	report_progress(false), file(f), capacity(STREAM_CHUNK_SIZE), begin(0), end(0), newline(0), scanned(0), quote_scanned(0), newline_found(false), eof(false), expression_start(true),
+	depth(0), file_size(0), list_start(0), lines(0)
+{
+	buffer = new char [capacity + 1];
+	buffer[0] = '\0';
+
+	struct stat sb;
+	if(fstat(fileno(file), &sb) == 0 && S_ISREG(sb.st_mode))
+		file_size = sb.st_size;
+}
+
+/*
+Move the unconsumed bytes to the front of the buffer and read the next chunk after them.
+Returns false if nothing more could be read.
+*/
+bool stream_reader::fill()
+{
+	if(eof) return false;
+
+	size_t n = end - begin;
+	memmove(buffer, buffer + begin, n);
+	newline_found = newline_found && newline >= begin;
+	newline -= begin;
+	scanned = (scanned > begin) ? scanned - begin : 0;
+	quote_scanned = (quote_scanned > begin) ? quote_scanned - begin : 0;
+	begin = 0;
+	end = n;
+	if(end == capacity)
+	{
+		char* larger = new char [2 * capacity + 1];
+		memcpy(larger, buffer, end);
+		delete [] buffer;
+		buffer = larger;
+		capacity *= 2;
+	}
+
+	//use read(2) rather than fread, which would wait for a whole chunk on a terminal.
+	ssize_t r;
+	uint64_t start = monotonic_ns();
+	do
+	{
+		r = read(fileno(file), buffer + end, capacity - end);
+	} while(r < 0 && errno == EINTR);
+	input_wait += monotonic_ns() - start;
+
+	if(r <= 0)
+		eof = true;
+	else
+		end += r;
+	buffer[end] = '\0';
+	return r > 0;
+}
+
+//true if the buffer holds the whole token at begin. a string literal is whole once its closing quote, or the end of
+//its line, is buffered.
+bool stream_reader::token_complete()
+{
+	if(eof)
+		return true;
+	if(begin < end && buffer[begin] == '\'')
+	{
+		for(size_t i = max(begin + 1, quote_scanned); i < end; ++i)
+			if(buffer[i] == '\'' || buffer[i] == '\n')
+				return true;
+		quote_scanned = end;
+		return false;
+	}
+	if(end - begin >= STREAM_LOOKAHEAD)
+		return true;
+	if(newline_found && newline >= begin)
+		return true;
+
+	size_t from = (scanned > begin) ? scanned : begin;
+	const char* n = (const char*) memchr(buffer + from, '\n', end - from);
+	scanned = n ? (n - buffer) + 1 : end;
+	if(n)
+	{
+		newline = n - buffer;
+		newline_found = true;
+	}
+	return n != NULL;
+}
+
+void stream_reader::next_token(token_t* t)
+{
+	t->type = OP_EOF;
+	while(true)
+	{
+		while(begin < end && (buffer[begin] == ' ' || buffer[begin] == '\t' || buffer[begin] == '\r' ||
+			(buffer[begin] == '\n' && depth > 0)))
+			consume(1);
+
+		if(begin < end)
+			break;
+		if(!fill())
+			return;
+	}
+
+	if(buffer[begin] == '\n')
+	{
+		consume(1);
+		depth = 0;
+		expression_start = true;
+		return;
+	}
+
+	while(!token_complete() && fill())
+		;
+
+	if(expression_start)
+		profile_here.line = expression_line = lines + 1;
+
+	const char* p = buffer + begin;
+	const char* q = get_next_token(p, t);
+	if(q == NULL || q > buffer + end)
+		q = buffer + end;
+	consume(q - p);
+
+	expression_start = false;
+	++tokens_read;
+	switch(t->type)
+	{
+		case OP_OPEN_BRACE:
+			if(depth++ == 0)
+				list_start = bytes_consumed;
+			break;
+		case OP_CLOSE_BRACE:
+			if(depth > 0 && --depth == 0 && report_progress && list_elements >= STREAM_PROGRESS_INTERVAL)
+				fprintf(stderr, "\nread %lu list elements, %lu bytes\n", list_elements, bytes_consumed);
+			break;
+		case OP_OBJECT:
+		case OP_VARIABLE:
+			if(depth > 0 && ++list_elements % STREAM_PROGRESS_INTERVAL == 0 && report_progress)
+				fprintf(stderr, "\rread %lu list elements, %lu bytes", list_elements, bytes_consumed);
+			break;
+	}
+}
+
+//extrapolate the length of the list from the bytes its first n elements took up, for regular files. the rest of the
+//file need not be part of the list, so the prediction grows the list twofold at most, like the growth it replaces;
+//it only saves the storage past the end of the list.
+size_t stream_reader::list_size_hint(size_t n)
+{
+	size_t used = bytes_consumed - list_start;
+	if(file_size <= bytes_consumed || used == 0)
+		return n;
+	size_t predicted = n + (size_t) ((double) (file_size - bytes_consumed) * n / used);
+	return min(predicted, 2 * n);
+}
+
+bool stream_reader::at_end()
+{
+	return begin == end && !fill();
+}
+
+bool stream_reader::read_command(const char* cmd)
+{
+	size_t n = strlen(cmd);
+
+	while(!token_complete() && fill())
+		;
+	if(end - begin < n || strncmp(buffer + begin, cmd, n))
+		return false;
+	if(begin + n < end && buffer[begin + n] != '\n')
+		return false;
+
+	consume(begin + n < end ? n + 1 : n);
+	return true;
+}
+
+void stream_reader::end_expression()
+{
+	token_t t;
+	while(!expression_start)
+	{
+		next_token(&t);
+		if(t.type == OP_EOF)
+			break;
+		if(t.type == OP_OBJECT)
+			object::object_reap(t.objectp);
+	}
+	depth = 0;
+	expression_start = true;
+}
+
+#undef STREAM_PROGRESS_INTERVAL
+#undef STREAM_LOOKAHEAD
+#undef STREAM_CHUNK_SIZE
+
+/*
+Controls the evaluation of a postfix expression in slices. The evaluation is suspended at a safe point, between two
+operators, once the operators allowed by 'slice' have been evaluated. It is resumed by calling evaluate_postfix again
+with the same expression, stack and control, after slice has been replenished.
+*/
+class evaluation_control
+{
+	public:
+		evaluation_control(size_t n = 0) : position(0), slice(n), suspended(false), elapsed(0) {}
+
+		int position; //next token of the expression to be evaluated.
+		string cache_key; //of the expression, while its result is to be cached.
+		result_cache::input_versions cache_inputs; //versions of the variables read, as of the start.
+		size_t slice; //operators which may still be evaluated in the current slice.
+		bool suspended;
+		uint64_t elapsed; //time spent in the slices so far, for the latency of the whole evaluation.
+};
+
+token_t evaluate_binding(vector< token_t >& v, symboltable& st);
+
+/*
+Evaluate the well formed postfix expression in the vector v, and populate the result in 'result'.
+If control is given, the evaluation may be suspended, see evaluation_control. An evaluation which exceeds the budget
+of the current isolate is aborted.
+*/
+token_t evaluate_postfix(const vector< token_t > &v, stack< token_t> &s, symboltable& st, evaluation_control* control = NULL)
+{
+#define GET_OBJECT_POINTER(token, object_pointer, reporterror) do { \
+	if(token.type == OP_VARIABLE) \
+	{ \
+		if(!st.get_symbol(string(token.varname), object_pointer) && reporterror) \
+		{ \
+			err.error_code = ERROR_UNDEFINED_VARIABLE; \
+			goto cleanup_and_return_error; \
+		} \
+	} \
+	else if(token.type == OP_OBJECT) \
+		object_pointer = token.objectp; \
+} while(0)
+
+#define RETURN_IF_NULL(x) do { \
+	if(x == NULL) \
+	{ \
+		err.error_code = ERROR_UNDEFINED_OPERATOR; \
+		goto cleanup_and_return_error; \
+	} \
+} while(0)
+
+#define RETURN_IF_EMPTY do { \
+	if(s.empty()) \
+	{ \
+		err.error_code = ERROR_UNEXPECTED_END_OF_EXPRESSION; \
+		goto cleanup_and_return_error; \
+	} \
+} while(0)
+
+	token_t err;
+	err.type = OP_INVALID;
+
+	int i, j;
+	isolate* heap = isolate::current();
+
+	phase_timer timer(PHASE_EVALUATE);
+	trace_span span("evaluate_postfix");
+	span.set_arg("tokens", v.size());
+	if(control)
+	{
+		timer.carry(&control->elapsed);
+		control->suspended = false;
+	}
+
+	//a binding is a statement of its own. the table takes over its expression, constants and all.
+	if(!v.empty() && v.back().type == OP_BIND && !(control && control->position))
+	{
+		vector< token_t > binding(v);
+		return evaluate_binding(binding, st);
+	}
+
+	//a pure expression has the same result as long as the variables it reads have not changed.
+	result_cache* cache = st.get_cache();
+	string uncontrolled_key;
+	result_cache::input_versions uncontrolled_inputs;
+	string& cache_key = control ? control->cache_key : uncontrolled_key;
+	result_cache::input_versions& cache_inputs = control ? control->cache_inputs : uncontrolled_inputs;
+	if(cache && !(control && control->position))
+	{
+		object_pointer_t cached = NULL;
+		if(!cache->make_key(v, st, cache_key, cache_inputs))
+			cache_key.clear();
+		else
+			cached = cache->lookup(cache_key, st);
+		if(cached)
+		{
+			for(i = 0; i < v.size(); ++i)
+				if(v[i].type == OP_OBJECT)
+					object::object_reap(v[i].objectp);
+			token_t result;
+			result.type = OP_OBJECT;
+			result.objectp = cached;
+			return result;
+		}
+	}
+
+	for(i = control ? control->position : 0; i < v.size(); ++i)
+	{
+		j = i - 1; //Processing is complete upto j. In case of error, the cleanup code examines the vector from j.
+
+		if(is_evaluation_operator(v[i].type))
+		{
+			if(control && control->slice == 0)
+			{
+				control->position = i;
+				control->suspended = true;
+				timer.defer();
+				return err;
+			}
+			if(control) --control->slice;
+			if(!heap->charge(1))
+			{
+				err.error_code = ERROR_BUDGET_EXCEEDED;
+				goto cleanup_and_return_error;
+			}
+			heap->count_operator(v[i].type);
+			profile_here.activity = PHASE_COUNT + v[i].type;
+		}
+
+		if(v[i].type == OP_OBJECT || v[i].type == OP_VARIABLE)
+		{
+			profile_here.activity = PHASE_EVALUATE;
+			s.push(v[i]);
+		}
+		else if(is_evaluation_operator(v[i].type))
+		{
+			//Evaluate the expression (operator op) for unary operators.
+			if(is_unary_operator(v[i].type))
+			{
+				RETURN_IF_EMPTY;
+				token_t op = s.top();
+				s.pop();
+				object_pointer_t p = NULL, r = NULL;
+				GET_OBJECT_POINTER(op, p, true);
+				switch(v[i].type)
+				{
+					case OP_BITWISE_NOT: r = ~(*p); break;
+					case OP_LOAD:
+						r = load_list(*p);
+						if(r == NULL)
+						{
+							if(op.type == OP_OBJECT) object::object_reap(p);
+							err.error_code = ERROR_CANNOT_LOAD;
+							goto cleanup_and_return_error;
+						}
+						break;
+				}
+				token_t result;
+				result.type = OP_OBJECT;
+				RETURN_IF_NULL(r);
+				result.objectp = r;
+				s.push(result);
+				if(op.type == OP_OBJECT) object::object_reap(p);
+				if(heap->budget_exceeded)
+				{
+					err.error_code = ERROR_BUDGET_EXCEEDED;
+					goto cleanup_and_return_error;
+				}
+				continue;
+			}
+
+			//Evaluate the expression (op1 operator op2) for a binary operators.
+			RETURN_IF_EMPTY;
+			token_t op2 = s.top();
+			s.pop();
+			RETURN_IF_EMPTY;
+			token_t op1 = s.top();
+			s.pop();
+			
+			object_pointer_t p1 = NULL, p2 = NULL, r = NULL;
+
+			//For assignment op1 need not already be a defined variable. Only the value of the session is replaced,
+			//a global symbol of the same name is hidden by the assignment.
+			if(v[i].type == OP_ASSIGN && op1.type == OP_VARIABLE)
+				st.get_local_symbol(string(op1.varname), p1);
+			else if(v[i].type == OP_ASSIGN)
+				GET_OBJECT_POINTER(op1, p1, false);
+			else
+				GET_OBJECT_POINTER(op1, p1, true);
+
+			GET_OBJECT_POINTER(op2, p2, true);
+
+			switch(v[i].type)
+			{
+				case OP_ADD: 		r = *p1 + *p2 ; break;
+				case OP_SUBTRACT: 	r = *p1 - *p2 ; break;
+				case OP_MULTIPLY: 	r = *p1 * *p2 ; break;
+				case OP_DIVIDE: 	r = *p1 / *p2 ; break;
+				case OP_MODULO: 	r = *p1 % *p2 ; break;
+				case OP_BITWISE_AND: 	r = *p1 & *p2 ; break;
+				case OP_BITWISE_OR: 	r = *p1 | *p2 ; break;
+				case OP_BITWISE_XOR: 	r = *p1 ^ *p2 ; break;
+				case OP_EQUAL: 		r = *p1 == *p2 ; break;
+				case OP_LESS: 		r = *p1 < *p2 ; break;
+				case OP_GREATER: 	r = *p1 > *p2 ; break;
+				case OP_FIND: 		r = find_string(*p1, *p2); break;
+				case OP_ASSIGN:
+				//op1 should be a variable, otherwise generate an error.
+				if(op1.type != OP_VARIABLE)
+				{
+					err.error_code = ERROR_ASSIGNMENT_TO_CONSTANT;
+					s.push(op1); s.push(op2);			
+					goto cleanup_and_return_error;
+				}
+				string lvalue(op1.varname);
+				st.set_symbol(lvalue, p2);
+				if(p2) p2->increment_refcount();
+				if(p1) p1->decrement_refcount();
+				r = p2;
+			}
+			token_t result;
+			result.type = OP_OBJECT;
+			RETURN_IF_NULL(r);
+			result.objectp = r;
+			s.push(result);
+
+			//If objects used in the expression are constants, we can release them.
+			if(v[i].type != OP_ASSIGN)
+			{
+				if(op1.type == OP_OBJECT) object::object_reap(p1);
+				if(op2.type == OP_OBJECT) object::object_reap(p2);
+			}
+
+			//an operator may have stopped short of its result, once the budget was exceeded.
+			if(heap->budget_exceeded)
+			{
+				err.error_code = ERROR_BUDGET_EXCEEDED;
+				goto cleanup_and_return_error;
+			}
+		}
+		else
+		{
+			err.error_code = ERROR_BAD_EXPRESSION;
+			goto cleanup_and_return_error;
+		}
+	}
+	j = i - 1;
+	
+	//The stack should have had exactly one element after completion of evaluation.
+	if(s.size() != 1)
+		err.error_code = ERROR_BAD_EXPRESSION;
+	else
+	{
+		token_t res = s.top(); //No errors detected during evaluation.
+		s.pop();
+		object_pointer_t p = NULL;
+		GET_OBJECT_POINTER(res, p, true);
+		res.type = OP_OBJECT;
+		res.objectp = p;
+		if(cache && !cache_key.empty())
+			cache->insert(cache_key, cache_inputs, p);
+		return res;
+	}
+	
+cleanup_and_return_error:
+	for( ++j ; j < v.size(); ++j)
+	{
+		if(v[j].type == OP_OBJECT)
+		{
+			object_pointer_t p = NULL;
+			GET_OBJECT_POINTER(v[j], p, true);
+			object::object_reap(p);
+		}
+	}
+	while(!s.empty())
+	{
+		token_t t = s.top();
+		s.pop();
+		if(t.type == OP_OBJECT)
+		{
+			object_pointer_t p = NULL;
+			GET_OBJECT_POINTER(t, p, true);
+			object::object_reap(p);
+		}
+	}
+
+	return err;
+
+#undef RETURN_IF_EMPTY
+#undef RETURN_IF_NULL
+#undef GET_OBJECT_POINTER
+}
+
+/*
+Assign a priority value for each operator.
+*/
+int priority_value(operator_t x)
+{
+	switch(x)
+	{
+		case OP_ADD :
+		case OP_SUBTRACT : return 0;
+		
+		case OP_MULTIPLY :
+		case OP_DIVIDE : return 5;
+
+		case OP_BITWISE_AND:
+		case OP_BITWISE_OR:
+		case OP_BITWISE_XOR: return 0;
+		case OP_BITWISE_NOT:
+		case OP_LOAD: return 10;
+
+		case OP_EQUAL:
+		case OP_LESS:
+		case OP_GREATER:
+		case OP_FIND: return -2;
+
+		case OP_ASSIGN : return -5;
+		case OP_BIND : return -10;
+	}
+	return 0;
+}
+
+/*
+Return
+1: If operator x is of higher priority than operator y.
+0: x and y are of same priority.
+-1: If operator y is of higher priority than operator x.
+*/
+int is_higher_priority(operator_t x, operator_t y)
+{
+	int i = priority_value(x) - priority_value(y);
+
+	//Operators such as = have to be evaluated from right to left.
+	if(x == OP_ASSIGN && y == OP_ASSIGN)
+		return -1;
+
+	return (i > 0) ? 1 : (i == 0 ? 0 : -1);
+}
+
+/*
+Copy the postfix expression src to dst. Constants are cloned, because evaluate_postfix releases the constants of
+the expression it evaluates.
+*/
+void clone_postfix(const vector< token_t >& src, vector< token_t >& dst)
+{
+	dst = src;
+	for(int i = 0; i < dst.size(); ++i)
+		if(dst[i].type == OP_OBJECT)
+			dst[i].objectp = object::clone_object(dst[i].objectp);
+}
+
+//release the constants of a postfix expression which is not going to be evaluated.
+void release_postfix(vector< token_t >& v)
+{
+	for(int i = 0; i < v.size(); ++i)
+		if(v[i].type == OP_OBJECT)
+			object::object_reap(v[i].objectp);
+	v.clear();
+}
+
+//evaluates a dirty bound variable. it stays dirty if the evaluation fails, an input being undefined, say, and the
+//error is set if error is not NULL.
+bool symboltable::recompute(const string& var, binding& b, int* error)
+{
+	vector< token_t > v;
+	stack< token_t > s;
+	clone_postfix(b.postfix, v);
+	unsigned long generation = global ? global->generation() : 0; //inputs published from now on are newer.
+	token_t t = evaluate_postfix(v, s, *this);
+	if(t.type != OP_OBJECT || t.objectp == NULL)
+	{
+		if(error && t.type == OP_INVALID)
+			*error = t.error_code;
+		return false;
+	}
+
+	object_pointer_t& value = st[var];
+	t.objectp->increment_refcount();
+	if(value) value->decrement_refcount();
+	value = t.objectp;
+	b.dirty = false;
+	b.generation = generation;
+	changed(var);
+	return true;
+}
+
+//the values of the global table, which bound expressions may read, change when it publishes.
+bool symboltable::stale(const binding& b) const
+{
+	return b.dirty || (global && global->generation() != b.generation);
+}
+
+/*
+Evaluate the binding var := expression, whose postfix form is var, the expression and :=. The value of the
+variable is returned, so the expression is evaluated once right away.
+*/
+token_t evaluate_binding(vector< token_t >& v, symboltable& st)
+{
+	token_t err;
+	err.type = OP_INVALID;
+	err.error_code = ERROR_BAD_EXPRESSION;
+
+	//bound expressions must not assign or bind, since evaluating them must not change other variables.
+	bool valid = v.size() >= 3 && v[0].type == OP_VARIABLE;
+	for(int i = 1; valid && i < v.size() - 1; ++i)
+		valid = (v[i].type != OP_ASSIGN && v[i].type != OP_BIND);
+	if(!valid)
+	{
+		release_postfix(v);
+		return err;
+	}
+
+	string var(v[0].varname);
+	vector< token_t > expression(v.begin() + 1, v.end() - 1);
+	v.clear();
+	int error;
+	if(!st.bind_symbol(var, expression, error))
+	{
+		release_postfix(expression);
+		err.error_code = error;
+		return err;
+	}
+
+	token_t t;
+	t.type = OP_OBJECT;
+	if(!st.get_symbol(var, t.objectp))
+	{
+		err.error_code = ERROR_UNDEFINED_VARIABLE;
+		return err;
+	}
+	return t;
+}
+
+/*
+Read the tokens of one infix expression from r into the vector tokens. List literals are turned into list objects.
+Returns a token of type OP_EOF on success, or OP_INVALID with the error code set.
+*/
+token_t tokenize_infix(token_reader& r, vector< token_t >& tokens)
+{
+	phase_timer timer(PHASE_TOKENIZE);
+	timer.exclude(&r.input_wait);
+	trace_span span("tokenize");
+	token_t t;
+
+	while(true)
+	{
+		r.next_token(&t);
+		
+		switch(t.type)
+		{
+			//incoming opening brace. read the token stream until OP_CLOSE_BRACE is received, and create a list
+			//object if successful. otherwise report error.
+			case OP_OPEN_BRACE:
+			{
+				object_pointer_t list = object::create_object(OBJECT_LIST);
+				size_t n = 0, next_hint = LIST_SIZE_HINT_SAMPLE;
+				do
+				{
+					r.next_token(&t);
+					switch(t.type)
+					{
+						case OP_OBJECT:
+							object::add_object_to_list(list, t.objectp);
+							//once the size of the elements is known, readers of large inputs can predict the
+							//length of the list and save reserving storage past its end.
+							if(++n == next_hint)
+							{
+								size_t hint = r.list_size_hint(n);
+								object::reserve_list(list, hint);
+								next_hint = (hint > n) ? hint : 0;
+							}
+							break;
+						case OP_SEPARATOR: break;
+						case OP_CLOSE_BRACE:
+							t.type = OP_OBJECT;
+							t.objectp = list;
+							tokens.push_back(t);
+							goto last_statement_main_loop;
+					}
+				} while(t.type != OP_EOF);
+
+				object::object_reap(list);
+				t.type = OP_INVALID;
+				t.error_code = ERROR_UNEXPECTED_END_OF_EXPRESSION;
+				release_postfix(tokens);
+				return t;
+			}
+			case OP_EOF: return t;
+			case OP_INVALID:
+				release_postfix(tokens);
+				return t;
+			default:
+				tokens.push_back(t);
+		}
+last_statement_main_loop:
+		;
+	}
+}
+
+/*
+Convert the infix expression in the vector tokens to postfix and populate the vector v.
+Returns a token of type OP_EOF on success, or OP_INVALID with the error code set.
+*/
+token_t infix_to_postfix(const vector< token_t >& tokens, vector< token_t >& v)
+{
+#define POP_ALL do { \
+	while(!s.empty()) \
+	{ \
+		token_t top = s.top(); \
+		if(top.type != OP_OPEN_SCOPE) \
+			v.push_back(top); \
+		s.pop(); \
+	} \
+} while(0)
+
+#define POP_AND_POPULATE_VECTOR do { \
+	while(!s.empty()) \
+	{ \
+		token_t top = s.top(); \
+		if(top.type == OP_OPEN_SCOPE) break; \
+		v.push_back(top); \
+		s.pop(); \
+	} \
+} while(0)
+
+#define POP_HIGH_PRIORITY_AND_POPULATE_VECTOR do { \
+	while(!s.empty()) \
+	{ \
+		token_t top = s.top(); \
+		if(top.type == OP_OPEN_SCOPE) break; \
+		if(is_higher_priority(top.type, t.type) < 0) break; \
+		v.push_back(top); \
+		s.pop(); \
+	} \
+} while(0)
+
+	phase_timer timer(PHASE_COMPILE);
+	trace_span span("infix_to_postfix");
+	span.set_arg("tokens", tokens.size());
+	stack < token_t > s; //Used for conversion from infix to postfix.
+
+	token_t t;
+
+	v.reserve(v.size() + tokens.size());
+	for(int i = 0; i < tokens.size(); ++i)
+	{
+		t = tokens[i];
+		
+		switch(t.type)
+		{
+			case OP_OBJECT:
+			case OP_VARIABLE:
+				v.push_back(t);
+				break;
+
+			case OP_ADD:
+			case OP_SUBTRACT:
+			case OP_MULTIPLY:
+			case OP_DIVIDE:
+			case OP_MODULO:
+			case OP_ASSIGN:
+			case OP_BITWISE_AND:
+			case OP_BITWISE_OR:
+			case OP_BITWISE_XOR:
+			case OP_BITWISE_NOT:
+			case OP_LOAD:
+			case OP_BIND:
+			case OP_EQUAL:
+			case OP_LESS:
+			case OP_GREATER:
+			case OP_FIND:
+			//incoming operator; pop operators from the stack which are of higher priority, put them into the vector and then push
+			//this element into the stack.
+				POP_HIGH_PRIORITY_AND_POPULATE_VECTOR;
+				s.push(t); break;
+			case OP_OPEN_SCOPE:
+				s.push(t); break;
+			case OP_CLOSE_SCOPE:
+			//pop operators from the stack and put them into the vector until an OP_OPEN_SCOPE type is removed.
+				POP_AND_POPULATE_VECTOR;
+				break;
+		}
+	}
+	POP_ALL;
+
+	t.type = OP_EOF;
+	return t;
+
+#undef POP_HIGH_PRIORITY_AND_POPULATE_VECTOR
+#undef POP_AND_POPULATE_VECTOR
+#undef POP_ALL
+}
+
+/*
+Convert the infix expression read from r to postfix and populate the vector v.
+Returns a token of type OP_EOF on success, or OP_INVALID with the error code set.
+*/
+token_t compile_infix(token_reader& r, vector< token_t >& v)
+{
+	vector< token_t > tokens;
+
+	token_t t = tokenize_infix(r, tokens);
+	if(t.type == OP_INVALID)
+		return t;
+
+	return infix_to_postfix(tokens, v);
+}
+
+token_t compile_infix(const char* p, vector< token_t >& v)
+{
+	token_t t;
+
+	t.type = OP_INVALID;
+	t.error_code = ERROR_PARSING_ERROR;
+	if(p == NULL) return t;
+
+	string_reader r(p);
+	return compile_infix(r, v);
+}
+
+/*
+Evaluate the infix expression read from r.
+*/
+token_t evaluate_infix(token_reader& r, symboltable& st)
+{
+	vector< token_t > v; //Vector that stores the postfix expression.
+	stack < token_t > s;
+
+	token_t t = compile_infix(r, v);
+	if(t.type == OP_INVALID)
+		return t;
+
+	return evaluate_postfix(v, s, st);
+}
+
+/*
+Evaluate the infix expression pointed by p.
+*/
+token_t evaluate_infix(const char* p, symboltable& st)
+{
+	vector< token_t > v; //Vector that stores the postfix expression.
+	stack < token_t > s;
+
+	token_t t = compile_infix(p, v);
+	if(t.type == OP_INVALID)
+		return t;
+
+	return evaluate_postfix(v, s, st);
+}
+
+/*
+Read one line of arbitrary length from file into line, without the trailing newline.
+Returns false at end of file.
+*/
+bool read_line(FILE* file, string& line)
+{
+	char chunk[128];
+	line.clear();
+	while(fgets(chunk, sizeof(chunk), file))
+	{
+		size_t n = strlen(chunk);
+		if(n && chunk[n - 1] == '\n')
+		{
+			line.append(chunk, n - 1);
+			return true;
+		}
+		line.append(chunk, n);
+	}
+	return !line.empty();
+}
+
+void run_testcases_from_file(FILE* file, symboltable& st)
+{
+	string expr, expected_result;
+	string result;
+	int i = 0, p = 0;
+	
+	while(read_line(file, expr))
+	{
+		if(expr == "quit")
+			break;
+		global_read_section section(st);
+		token_t t = evaluate_infix(expr.c_str(), st);
+		read_line(file, expected_result);
+
+		//an expression which is expected to fail has the message of its error as the expected result.
+		if(t.type == OP_OBJECT && t.objectp)
+			result = object::debug_string(t.objectp);
+		else if(t.type == OP_INVALID)
+			result = string("error: ") + error_codes[t.error_code];
+		else
+			result.clear();
+
+		if(expected_result == result)
+			++p, printf("test case [%s] *PASS*\n", expr.c_str());
+		else
+			printf("test case [%s] expected [%s] obtained [%s] *FAIL*\n", expr.c_str(), expected_result.c_str(),
+				result.c_str());
+		++i;		
+	}
+	printf("total test cases=%d passed=%d failed=%d\n", i, p, i-p);
+}
+
+#ifndef NEO_LIBRARY
+//see run_from_stream.
+const char* script_command(const string& line);
+void run_script_command(const char* command, symboltable& st);
+
+/*
+Parallel evaluation of scripts.
+Every statement of the script is compiled up front, and the variables it reads and writes are collected from its
+postfix form. A statement depends on the earlier statements that write a variable it reads or writes, and on the
+earlier statements that read a variable it writes. Statements whose dependencies have completed are evaluated
+concurrently by a pool of worker threads, while results are printed in script order.
+Reading a bound variable reads its inputs, and writes the variable itself when it is dirty. Statements which bind
+a variable, or assign to a bound one, change the bindings of the table, and run after all earlier statements and
+before all later ones. So do the commands of the script, such as metrics, which the calling thread runs in turn.
+*/
+class script_statement
+{
+	public:
+		string text;
+		uint32_t line;
+		vector< token_t > postfix;
+		token_t result;
+
+		set< string > reads;
+		set< string > writes;
+		string bound; //the variable bound by the statement, if any.
+		const char* command; //the script command given instead of a statement, or NULL.
+
+		vector< int > dependents; //statements that wait for this one to complete.
+		int pending; //number of statements this one still waits for.
+		bool done;
+
+		script_statement() : line(0), command(NULL), pending(0), done(false) {}
+};
+
+class parallel_script
+{
+	public:
+		parallel_script(symboltable& table) : st(table), heap(true), undispatched(0)
+		{
+			pthread_mutex_init(&lock, NULL);
+			pthread_cond_init(&ready_cond, NULL);
+			pthread_cond_init(&done_cond, NULL);
+		}
+		~parallel_script()
+		{
+			pthread_cond_destroy(&done_cond);
+			pthread_cond_destroy(&ready_cond);
+			pthread_mutex_destroy(&lock);
+		}
+
+		void add_statement(const string& text, uint32_t line = 0);
+		void run(int threads);
+
+	private:
+		symboltable& st;
+		vector< script_statement > statements;
+
+		//statements running on different threads share their objects.
+		isolate heap;
+
+		deque< int > ready; //statements whose dependencies have completed.
+		int undispatched;
+
+		pthread_mutex_t lock;
+		pthread_cond_t ready_cond;
+		pthread_cond_t done_cond;
+
+		void collect_variables(script_statement& s);
+		void build_dependencies();
+		void complete(int i);
+
+		static void* worker(void* arg);
+};
+
+void parallel_script::add_statement(const string& text, uint32_t line)
+{
+	isolate_scope scope(&heap);
+	statements.push_back(script_statement());
+	script_statement& s = statements.back();
+
+	s.text = text;
+	s.line = line;
+	s.command = script_command(text);
+	if(s.command)
+	{
+		s.result.type = OP_EOF;
+		return;
+	}
+	profile_here.line = line;
+	s.result = compile_infix(text.c_str(), s.postfix);
+	if(s.result.type == OP_INVALID)
+		s.postfix.clear();
+	else
+		collect_variables(s);
+}
+
+/*
+Simulate the evaluation of the postfix expression to find out which variables are assigned to and which are read.
+*/
+void parallel_script::collect_variables(script_statement& s)
+{
+#define POP_OPERAND(x) do { \
+	x = NULL; \
+	if(!operands.empty()) \
+	{ \
+		x = operands.top(); \
+		operands.pop(); \
+	} \
+} while(0)
+
+	stack< const token_t* > operands; //NULL stands for an intermediate result or a constant.
+	const token_t *op1, *op2;
+
+	for(int i = 0; i < s.postfix.size(); ++i)
+	{
+		const token_t& t = s.postfix[i];
+		if(t.type == OP_VARIABLE)
+			operands.push(&t);
+		else if(t.type == OP_OBJECT)
+			operands.push(NULL);
+		else if(is_unary_operator(t.type))
+		{
+			POP_OPERAND(op1);
+			if(op1) s.reads.insert(op1->varname);
+			operands.push(NULL);
+		}
+		else
+		{
+			POP_OPERAND(op2);
+			POP_OPERAND(op1);
+			if(op2) s.reads.insert(op2->varname);
+			if(op1) (t.type == OP_ASSIGN || t.type == OP_BIND ? s.writes : s.reads).insert(op1->varname);
+			if(op1 && t.type == OP_BIND) s.bound = op1->varname;
+			operands.push(NULL);
+		}
+	}
+	while(!operands.empty())
+	{
+		if(operands.top()) s.reads.insert(operands.top()->varname);
+		operands.pop();
+	}
+
+#undef POP_OPERAND
+}
+
+void parallel_script::build_dependencies()
+{
+	map< string, int > last_writer;
+	map< string, vector< int > > readers; //readers of a variable since it was last written.
+	map< string, set< string > > bound; //inputs of the variables bound so far.
+	int barrier = -1;
+	vector< int > since_barrier;
+
+	st.get_bindings(bound); //made before the script.
+
+	for(int i = 0; i < statements.size(); ++i)
+	{
+		script_statement& s = statements[i];
+		set< int > depends;
+		set< string >::iterator v;
+
+		bool is_barrier = !s.bound.empty() || s.command;
+		for(v = s.writes.begin(); v != s.writes.end(); ++v)
+			is_barrier = is_barrier || bound.count(*v);
+		if(!s.bound.empty())
+			bound[s.bound] = s.reads;
+		else
+			for(v = s.writes.begin(); v != s.writes.end(); ++v)
+				bound.erase(*v);
+
+		//add the variables read through bound variables.
+		vector< string > pending(s.reads.begin(), s.reads.end());
+		while(!pending.empty())
+		{
+			string r = pending.back();
+			pending.pop_back();
+			map< string, set< string > >::iterator b = bound.find(r);
+			if(b == bound.end() || !s.writes.insert(r).second)
+				continue;
+			for(v = (*b).second.begin(); v != (*b).second.end(); ++v)
+			{
+				s.reads.insert(*v);
+				pending.push_back(*v);
+			}
+		}
+
+		if(is_barrier)
+			depends.insert(since_barrier.begin(), since_barrier.end());
+		if(barrier >= 0)
+			depends.insert(barrier);
+		if(is_barrier)
+		{
+			barrier = i;
+			since_barrier.clear();
+		}
+		else
+			since_barrier.push_back(i);
+
+		for(v = s.reads.begin(); v != s.reads.end(); ++v)
+		{
+			map< string, int >::iterator w = last_writer.find(*v);
+			if(w != last_writer.end()) depends.insert((*w).second);
+		}
+		for(v = s.writes.begin(); v != s.writes.end(); ++v)
+		{
+			map< string, int >::iterator w = last_writer.find(*v);
+			if(w != last_writer.end()) depends.insert((*w).second);
+
+			vector< int >& r = readers[*v];
+			depends.insert(r.begin(), r.end());
+		}
+		depends.erase(i);
+
+		for(set< int >::iterator d = depends.begin(); d != depends.end(); ++d)
+			statements[*d].dependents.push_back(i);
+		s.pending = depends.size();
+
+		for(v = s.reads.begin(); v != s.reads.end(); ++v)
+			readers[*v].push_back(i);
+		for(v = s.writes.begin(); v != s.writes.end(); ++v)
+		{
+			last_writer[*v] = i;
+			readers[*v].clear();
+			//make sure assignments never insert into the symbol table while other statements look it up.
+			st.reserve_symbol(*v);
+		}
+	}
+}
+
+//must be called with lock held.
+void parallel_script::complete(int i)
+{
+	script_statement& s = statements[i];
+	for(int k = 0; k < s.dependents.size(); ++k)
+	{
+		//commands are not dispatched to the workers, but run by the calling thread.
+		if(--statements[s.dependents[k]].pending == 0 && !statements[s.dependents[k]].command)
+			ready.push_back(s.dependents[k]);
+	}
+	s.done = true;
+	pthread_cond_broadcast(&ready_cond);
+	pthread_cond_broadcast(&done_cond);
+}
+
+void* parallel_script::worker(void* arg)
+{
+	parallel_script* ps = (parallel_script*) arg;
+	isolate_scope scope(&ps->heap);
+	stack< token_t > s;
+
+	pthread_mutex_lock(&ps->lock);
+	while(true)
+	{
+		while(ps->ready.empty() && ps->undispatched > 0)
+			pthread_cond_wait(&ps->ready_cond, &ps->lock);
+		if(ps->ready.empty())
+			break;
+
+		int i = ps->ready.front();
+		ps->ready.pop_front();
+		--ps->undispatched;
+		pthread_mutex_unlock(&ps->lock);
+
+		script_statement& stmt = ps->statements[i];
+		if(stmt.result.type != OP_INVALID)
+		{
+			global_read_section section(ps->st);
+			profile_here.line = stmt.line;
+			stmt.result = evaluate_postfix(stmt.postfix, s, ps->st);
+			//hold on to the result until it is printed, a later statement may reassign the variable it came from.
+			if(stmt.result.type == OP_OBJECT && stmt.result.objectp)
+				stmt.result.objectp->increment_refcount();
+		}
+
+		pthread_mutex_lock(&ps->lock);
+		ps->complete(i);
+	}
+	pthread_mutex_unlock(&ps->lock);
+	return NULL;
+}
+
+void parallel_script::run(int threads)
+{
+	isolate_scope scope(&heap);
+	build_dependencies();
+
+	undispatched = 0;
+	for(int i = 0; i < statements.size(); ++i)
+	{
+		if(statements[i].command)
+			continue;
+		++undispatched;
+		if(statements[i].pending == 0)
+			ready.push_back(i);
+	}
+
+	vector< pthread_t > pool(threads);
+	for(int k = 0; k < threads; ++k)
+		pthread_create(&pool[k], NULL, parallel_script::worker, this);
+
+	for(int i = 0; i < statements.size(); ++i)
+	{
+		pthread_mutex_lock(&lock);
+		if(statements[i].command)
+		{
+			while(statements[i].pending > 0)
+				pthread_cond_wait(&done_cond, &lock);
+			pthread_mutex_unlock(&lock);
+			run_script_command(statements[i].command, st);
+			pthread_mutex_lock(&lock);
+			complete(i);
+			pthread_mutex_unlock(&lock);
+			continue;
+		}
+		while(!statements[i].done)
+			pthread_cond_wait(&done_cond, &lock);
+		pthread_mutex_unlock(&lock);
+
+		token_t& t = statements[i].result;
+		if(t.type == OP_OBJECT && t.objectp)
+		{
+			t.objectp->print_object();
+			t.objectp->decrement_refcount();
+		}
+		else
+			print_token(t);
+	}
+
+	for(int k = 0; k < threads; ++k)
+		pthread_join(pool[k], NULL);
+}
+
+void run_script_in_parallel(FILE* file, symboltable& st, int threads)
+{
+	parallel_script ps(st);
+	string line;
+	uint32_t number = 0;
+
+	while(read_line(file, line))
+	{
+		++number;
+		if(line == "quit")
+			break;
+		if(line.find_first_not_of(" \t") == string::npos)
+			continue;
+		ps.add_statement(line, number);
+	}
+	profile_here.line = 0;
+	ps.run(threads);
+}
+#endif
+
+//the statistics of the current isolate, and those of the result cache of st if it has one.
+string session_metrics_json(const symboltable& st)
+{
+	string json = isolate::current()->metrics_json();
+	if(st.get_cache())
+		json.insert(json.size() - 1, ", \"cache\": " + st.get_cache()->stats_json());
+	return json;
+}
+
+/*
+Embedding API, see neo.h.
+*/
+struct neo_context
+{
+	isolate heap;
+	symboltable st;
+	snapshot_image* image;
+};
+
+struct neo_program
+{
+	vector< token_t > postfix;
+	isolate* heap; //of the context the program was compiled in, which owns its constants.
+};
+
+/*
+A value returned by neo_evaluate or neo_eval holds a reference to its object and the isolate of the context it was
+returned by, which the object goes back to when it is released. The elements of a list are handed out as tagged
+pointers instead, which need not be released: the lowest bits of an object pointer are free, and the tag tells an
+element from a returned value.
+*/
+struct neo_value
+{
+	object* o;
+	isolate* heap;
+};
+
+#define VALUE_TAG_MASK ((uintptr_t) 3)
+#define VALUE_TAG_OBJECT ((uintptr_t) 1) //an object owned by a list.
+#define VALUE_TAG_INTEGER ((uintptr_t) 2) //an int32_t element of a list with mapped storage.
+#define VALUE_TAG_FLOAT ((uintptr_t) 3) //a double element of a list with mapped storage.
+#define VALUE_ELEMENT(v, t) (*(const t*) ((uintptr_t) (v) & ~VALUE_TAG_MASK))
+
+static const object* object_of(const neo_value* v)
+{
+	uintptr_t p = (uintptr_t) v;
+	if((p & VALUE_TAG_MASK) == VALUE_TAG_OBJECT)
+		return (const object*) (p & ~VALUE_TAG_MASK);
+	return v->o;
+}
+
+static neo_value* return_value(neo_context* ctx, object* o)
+{
+	o->increment_refcount();
+	neo_value* v = new neo_value();
+	v->o = o;
+	v->heap = &ctx->heap;
+	return v;
+}
+
+#define TO_OBJECT(v) object_of(v)
+
+//report the error carried by an OP_INVALID token.
+static void set_error(const char** error, const token_t& t)
+{
+	if(error)
+		*error = (t.type == OP_INVALID) ? error_codes[t.error_code] : error_codes[ERROR_BAD_EXPRESSION];
+}
+
+neo_context* neo_context_create(void)
+{
+	neo_context* ctx = new neo_context();
+	ctx->st.attach_global(&globals);
+	ctx->image = NULL;
+	return ctx;
+}
+
+void neo_context_destroy(neo_context* ctx)
+{
+	if(ctx == NULL) return;
+	{
+		isolate_scope scope(&ctx->heap);
+		ctx->st.clear();
+		delete ctx->image;
+	}
+	delete ctx;
+}
+
+neo_program* neo_compile(neo_context* ctx, const char* source, const char** error)
+{
+	isolate_scope scope(&ctx->heap);
+	neo_program* program = new neo_program();
+	program->heap = &ctx->heap;
+	token_t t = compile_infix(source, program->postfix);
+	if(t.type == OP_INVALID)
+	{
+		set_error(error, t);
+		release_postfix(program->postfix);
+		delete program;
+		return NULL;
+	}
+	return program;
+}
+
+void neo_program_free(neo_program* program)
+{
+	if(program == NULL) return;
+	{
+		isolate_scope scope(program->heap);
+		release_postfix(program->postfix);
+	}
+	delete program;
+}
+
+neo_value* neo_evaluate(neo_context* ctx, const neo_program* program, const char** error)
+{
+	isolate_scope scope(&ctx->heap);
+	vector< token_t > v;
+	stack< token_t > s;
+
+	clone_postfix(program->postfix, v);
+	global_read_section section(ctx->st);
+	token_t t = evaluate_postfix(v, s, ctx->st);
+	if(t.type != OP_OBJECT || t.objectp == NULL)
+	{
+		set_error(error, t);
+		return NULL;
+	}
+	return return_value(ctx, t.objectp);
+}
+
+neo_value* neo_eval(neo_context* ctx, const char* source, const char** error)
+{
+	isolate_scope scope(&ctx->heap);
+	vector< token_t > v;
+	stack< token_t > s;
+
+	global_read_section section(ctx->st);
+	token_t t = compile_infix(source, v);
+	if(t.type != OP_INVALID)
+		t = evaluate_postfix(v, s, ctx->st);
+	else
+		release_postfix(v);
+
+	if(t.type != OP_OBJECT || t.objectp == NULL)
+	{
+		set_error(error, t);
+		return NULL;
+	}
+	return return_value(ctx, t.objectp);
+}
+
+void neo_value_release(neo_value* value)
+{
+	if(value == NULL) return;
+	{
+		isolate_scope scope(value->heap);
+		value->o->decrement_refcount();
+	}
+	delete value;
+}
+
+void neo_define(neo_context* ctx, const char* name, neo_value* value)
+{
+	isolate_scope scope(&ctx->heap);
+	object_pointer_t o = value->o, previous = NULL;
+
+	object::share(o);
+	o->increment_refcount();
+	if(ctx->st.get_local_symbol(name, previous))
+		previous->decrement_refcount();
+	ctx->st.set_symbol(name, o);
+}
+
+void neo_global_define(const char* name, neo_value* value)
+{
+	globals.set_symbol(name, value->o);
+}
+
+void neo_global_publish(neo_context* ctx)
+{
+	isolate_scope scope(&ctx->heap);
+	globals.publish(ctx->st);
+}
+
+void neo_context_cache(neo_context* ctx, size_t entries)
+{
+	isolate_scope scope(&ctx->heap);
+	ctx->st.enable_cache(entries);
+}
+
+int neo_snapshot_write(neo_context* ctx, const char* path)
+{
+	isolate_scope scope(&ctx->heap);
+	return write_snapshot(ctx->st, path) ? 0 : -1;
+}
+
+int neo_snapshot_load(neo_context* ctx, const char* path)
+{
+	isolate_scope scope(&ctx->heap);
+	const char* error;
+	snapshot_image* image = snapshot_image::open(path, &error);
+	if(image == NULL)
+		return -1;
+	ctx->st.attach_image(image);
+	delete ctx->image;
+	ctx->image = image;
+	return 0;
+}
+
+int neo_global_load_snapshot(const char* path)
+{
+	const char* error;
+	snapshot_image* image = snapshot_image::open(path, &error);
+	if(image == NULL)
+		return -1;
+	globals.attach_image(image);
+	return 0;
+}
+
+void neo_trace_start(void)
+{
+	tracer::start();
+}
+
+void neo_trace_stop(void)
+{
+	tracer::stop();
+}
+
+int neo_trace_write(const char* path)
+{
+	FILE* f = fopen(path, "w");
+	if(f == NULL)
+		return -1;
+	bool written = tracer::write(f);
+	return (fclose(f) == 0 && written) ? 0 : -1;
+}
+
+size_t neo_context_metrics(neo_context* ctx, char* buffer, size_t length)
+{
+	isolate_scope scope(&ctx->heap);
+	string json = session_metrics_json(ctx->st);
+	if(length)
+	{
+		size_t n = (json.size() < length) ? json.size() : length - 1;
+		memcpy(buffer, json.c_str(), n);
+		buffer[n] = '\0';
+	}
+	return json.size();
+}
+
+//elements of mapped storage are handed out as tagged pointers to the numbers, and read in place.
+neo_type neo_value_type(const neo_value* value)
+{
+	switch((uintptr_t) value & VALUE_TAG_MASK)
+	{
+		case VALUE_TAG_INTEGER: return NEO_INTEGER;
+		case VALUE_TAG_FLOAT:   return NEO_FLOAT;
+	}
+	return (neo_type) TO_OBJECT(value)->get_type();
+}
+
+int neo_value_int(const neo_value* value)
+{
+	switch((uintptr_t) value & VALUE_TAG_MASK)
+	{
+		case VALUE_TAG_INTEGER: return VALUE_ELEMENT(value, int32_t);
+		case VALUE_TAG_FLOAT:   return (int) VALUE_ELEMENT(value, double);
+	}
+	return TO_OBJECT(value)->get_integer();
+}
+
+double neo_value_float(const neo_value* value)
+{
+	switch((uintptr_t) value & VALUE_TAG_MASK)
+	{
+		case VALUE_TAG_INTEGER: return VALUE_ELEMENT(value, int32_t);
+		case VALUE_TAG_FLOAT:   return VALUE_ELEMENT(value, double);
+	}
+	return TO_OBJECT(value)->get_float();
+}
+
+const char* neo_value_string(const neo_value* value)
+{
+	if(((uintptr_t) value & VALUE_TAG_MASK) > VALUE_TAG_OBJECT)
+		return NULL;
+	return TO_OBJECT(value)->get_string();
+}
+
+size_t neo_list_length(const neo_value* value)
+{
+	if(((uintptr_t) value & VALUE_TAG_MASK) > VALUE_TAG_OBJECT)
+		return 0;
+	return TO_OBJECT(value)->get_list_length();
+}
+
+const neo_value* neo_list_item(const neo_value* value, size_t i)
+{
+	if(((uintptr_t) value & VALUE_TAG_MASK) > VALUE_TAG_OBJECT)
+		return NULL;
+	const object* list = TO_OBJECT(value);
+	const mapped_array* a = list->get_mapped_array();
+	if(a && i < a->length && a->element_type == OBJECT_INTEGER)
+		return (const neo_value*) ((uintptr_t) ((const int32_t*) a->elements + i) | VALUE_TAG_INTEGER);
+	if(a && i < a->length)
+		return (const neo_value*) ((uintptr_t) ((const double*) a->elements + i) | VALUE_TAG_FLOAT);
+	const object* o = list->get_list_item(i);
+	return o ? (const neo_value*) ((uintptr_t) o | VALUE_TAG_OBJECT) : NULL;
+}
+
+#undef TO_OBJECT
+#undef VALUE_ELEMENT
+#undef VALUE_TAG_FLOAT
+#undef VALUE_TAG_INTEGER
+#undef VALUE_TAG_OBJECT
+#undef VALUE_TAG_MASK
+
+#ifndef NEO_LIBRARY
+const char prompt[] = "neo] ";
+
+//file the trace is written to, see -t and the 'trace' command.
+const char* trace_file = "neo.trace.json";
+
+bool write_trace()
+{
+	FILE* f = fopen(trace_file, "w");
+	if(f == NULL)
+		return false;
+	bool written = tracer::write(f);
+	return (fclose(f) == 0) && written;
+}
+
+void write_trace_at_exit()
+{
+	if(!tracer::enabled())
+		return;
+	tracer::stop();
+	if(!write_trace())
+		fprintf(stderr, "cannot write trace to %s\n", trace_file);
+}
+
+/*
+Sampling profiler of scripts. A SIGPROF timer interrupts the process after every millisecond of CPU time it used, and
+the signal handler notes the script line and the activity of the thread it interrupted (see profile_point). The
+samples are aggregated into a report of hot lines, hot operators and allocations by type.
+*/
+class profiler
+{
+	public:
+		static bool start();
+		static void stop();
+		static void report(FILE* out);
+
+	private:
+#define PROFILE_INTERVAL_US (1000)
+#define PROFILE_MAX_SAMPLES (1 << 20) //about 17 minutes of CPU time. later samples are counted, but not kept.
+		struct sample
+		{
+			uint32_t line;
+			int activity;
+		};
+		static sample* samples;
+		static uint64_t taken;
+
+		typedef vector< pair< string, uint64_t > > tally_t;
+
+		static void on_signal(int);
+		static bool more_samples(const pair< string, uint64_t >& a, const pair< string, uint64_t >& b)
+		{
+			return a.second > b.second;
+		}
+		static void print_top(FILE* out, const char* title, tally_t& tally, uint64_t total, size_t limit);
+};
+
+profiler::sample* profiler::samples = NULL;
+uint64_t profiler::taken = 0;
+
+//async-signal-safe: takes no locks and allocates nothing.
+void profiler::on_signal(int)
+{
+	uint64_t n = __sync_fetch_and_add(&taken, 1);
+	if(n < PROFILE_MAX_SAMPLES)
+	{
+		samples[n].line = profile_here.line;
+		samples[n].activity = profile_here.activity;
+	}
+}
+
+bool profiler::start()
+{
+	samples = new sample[PROFILE_MAX_SAMPLES];
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = profiler::on_signal;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	if(sigaction(SIGPROF, &sa, NULL) != 0)
+		return false;
+
+	struct itimerval timer;
+	timer.it_interval.tv_sec = 0;
+	timer.it_interval.tv_usec = PROFILE_INTERVAL_US;
+	timer.it_value = timer.it_interval;
+	return setitimer(ITIMER_PROF, &timer, NULL) == 0;
+}
+
+void profiler::stop()
+{
+	struct itimerval timer;
+	memset(&timer, 0, sizeof(timer));
+	setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+//prints the entries of tally with the most samples first. entries with as many samples keep their order.
+void profiler::print_top(FILE* out, const char* title, tally_t& tally, uint64_t total, size_t limit)
+{
+	stable_sort(tally.begin(), tally.end(), more_samples);
+
+	fprintf(out, "\n%-16s %10s %8s\n", title, "samples", "percent");
+	for(size_t i = 0; i < tally.size() && i < limit; ++i)
+		fprintf(out, "%-16s %10llu %7.1f%%\n", tally[i].first.c_str(), (unsigned long long) tally[i].second,
+			100.0 * tally[i].second / total);
+}
+
+void profiler::report(FILE* out)
+{
+#define PROFILE_REPORT_LINES (20)
+	uint64_t n = __atomic_load_n(&taken, __ATOMIC_RELAXED), kept = (n < PROFILE_MAX_SAMPLES) ? n : PROFILE_MAX_SAMPLES;
+	fprintf(out, "profile: %llu samples, one every %dus of CPU time", (unsigned long long) n, PROFILE_INTERVAL_US);
+	if(kept < n)
+		fprintf(out, ", the first %llu of them are reported", (unsigned long long) kept);
+	fprintf(out, "\n");
+
+	map< uint32_t, uint64_t > lines;
+	map< int, uint64_t > activities;
+	for(uint64_t i = 0; i < kept; ++i)
+	{
+		++lines[samples[i].line];
+		++activities[samples[i].activity];
+	}
+
+	tally_t tally;
+	char name[32];
+	for(map< uint32_t, uint64_t >::iterator i = lines.begin(); i != lines.end(); ++i)
+	{
+		//samples taken outside of scripts, like while the interpreter starts, have no line.
+		if(i->first)
+			snprintf(name, sizeof(name), "line %u", i->first);
+		else
+			snprintf(name, sizeof(name), "-");
+		tally.push_back(make_pair(string(name), i->second));
+	}
+	if(kept)
+		print_top(out, "hot lines", tally, kept, PROFILE_REPORT_LINES);
+
+	tally.clear();
+	for(map< int, uint64_t >::iterator i = activities.begin(); i != activities.end(); ++i)
+	{
+		int a = i->first;
+		if(a >= PHASE_COUNT)
+			snprintf(name, sizeof(name), "operator %s", operator_strings[a - PHASE_COUNT]);
+		else if(a >= 0)
+			snprintf(name, sizeof(name), "(%s)", phase_strings[a]);
+		else
+			snprintf(name, sizeof(name), "(other)");
+		tally.push_back(make_pair(string(name), i->second));
+	}
+	if(kept)
+		print_top(out, "hot operators", tally, kept, tally.size());
+
+	uint64_t created[OBJECT_TYPE_COUNT], payload[OBJECT_TYPE_COUNT];
+	isolate::allocation_totals(created, payload);
+	fprintf(out, "\n%-16s %10s %16s\n", "allocations", "objects", "bytes");
+	for(int i = OBJECT_INTEGER; i < OBJECT_TYPE_COUNT; ++i)
+		fprintf(out, "%-16s %10llu %16llu\n", object_type_strings[i], (unsigned long long) created[i],
+			(unsigned long long) (created[i] * sizeof(object) + payload[i]));
+#undef PROFILE_REPORT_LINES
+}
+
+#undef PROFILE_MAX_SAMPLES
+#undef PROFILE_INTERVAL_US
+
+void print_profile_at_exit()
+{
+	profiler::stop();
+	profiler::report(stderr);
+}
+
+/*
+Evaluate the expressions read from file one by one and print their results. In interactive mode a prompt is shown
+before each expression, and the commands 'quit' and 'm' are accepted. The command 'metrics' prints the statistics of
+the isolate as JSON and 'trace' starts tracing, or stops it and writes the trace, in either mode.
+*/
+//commands a script may give on a line of their own, besides quit. m is a command of the interactive loop only.
+static const char* script_commands[] = { "metrics", "trace", NULL };
+
+const char* script_command(const string& line)
+{
+	for(int i = 0; script_commands[i]; ++i)
+		if(line == script_commands[i])
+			return script_commands[i];
+	return NULL;
+}
+
+//consumes the line of r if it is a script command, and returns the command.
+const char* read_script_command(stream_reader& r)
+{
+	for(int i = 0; script_commands[i]; ++i)
+		if(r.read_command(script_commands[i]))
+			return script_commands[i];
+	return NULL;
+}
+
+void run_script_command(const char* command, symboltable& st)
+{
+	if(!strcmp(command, "metrics"))
+		printf("%s\n", session_metrics_json(st).c_str());
+	else if(!tracer::enabled())
+	{
+		tracer::start();
+		printf("tracing\n");
+	}
+	else
+	{
+		tracer::stop();
+		printf(write_trace() ? "trace written to %s\n" : "cannot write trace to %s\n", trace_file);
+	}
+}
+
+void run_from_stream(FILE* file, symboltable& st, bool interactive)
+{
+	stream_reader r(file);
+	r.report_progress = !interactive && isatty(fileno(stderr));
+
+	while(true)
+	{
+		token_t t;
+		if(interactive)
+		{
+			printf("%s", prompt);
+			fflush(stdout);
+		}
+		if(r.at_end())
+			break;
+		if(r.read_command("quit"))
+			break;
+		if(interactive && r.read_command("m"))
+		{
+			object::print_memory_stats();
+			if(st.get_cache())
+				st.get_cache()->print_stats(stdout);
+			continue;
+		}
+		const char* command = read_script_command(r);
+		if(command)
+		{
+			run_script_command(command, st);
+			continue;
+		}
+		global_read_section section(st);
+		t = evaluate_infix(r, st);
+		r.end_expression();
+		if(t.type == OP_OBJECT && t.objectp)	
+		{
+#ifdef DEBUG_NEO
+			t.objectp->print_object(true);
+#else	
+			t.objectp->print_object();
+#endif
+			//results which were not assigned to a variable are not needed any longer.
+			if(t.objectp->get_refcount() == 0)
+				object::object_reap(t.objectp);
+		}
+		else
+			print_token(t);
+	}
+	if(interactive)
+		printf("\n");
+}
+
+/*
+Bounded single producer, single consumer queue. It is lock free: only the producer writes the tail and only the
+consumer writes the head. A producer which finds the queue full, or a consumer which finds it empty, backs off and
+retries, which throttles a stage running ahead of the next one.
+*/
+template < class T > class spsc_queue
+{
+	public:
+		spsc_queue(size_t capacity) : items(capacity + 1), head(0), tail(0) {}
+
+		bool try_push(const T& item)
+		{
+			size_t t = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+			size_t next = (t + 1 == items.size()) ? 0 : t + 1;
+			if(next == __atomic_load_n(&head, __ATOMIC_ACQUIRE))
+				return false;
+			items[t] = item;
+			__atomic_store_n(&tail, next, __ATOMIC_RELEASE);
+			return true;
+		}
+
+		bool try_pop(T& item)
+		{
+			size_t h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+			if(h == __atomic_load_n(&tail, __ATOMIC_ACQUIRE))
+				return false;
+			item = items[h];
+			__atomic_store_n(&head, (h + 1 == items.size()) ? 0 : h + 1, __ATOMIC_RELEASE);
+			return true;
+		}
+
+		void push(const T& item)
+		{
+			for(int i = 0; !try_push(item); ++i)
+				backoff(i);
+		}
+
+		T pop()
+		{
+			T item;
+			for(int i = 0; !try_pop(item); ++i)
+				backoff(i);
+			return item;
+		}
+
+	private:
+		vector< T > items;
+
+		//head and tail are kept on cache lines of their own, so that the two threads do not contend for them.
+		char padding0[64];
+		size_t head;
+		char padding1[64];
+		size_t tail;
+		char padding2[64];
+
+		//spinning only pays off if the other thread is running on another core.
+		static void backoff(int attempt)
+		{
+			static const int spins = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? 100 : 0;
+			if(attempt < spins)
+				return;
+			else if(attempt < spins + 100)
+				sched_yield();
+			else
+				usleep(100);
+		}
+};
+
+/*
+Pipelined evaluation of scripts.
+A reader thread tokenizes the expressions of the script and a compiler thread converts them to postfix, while the
+calling thread evaluates them and prints the results in order. The stages are connected by bounded queues, so that
+parsing of the next expressions overlaps with evaluation of the current one. Expressions are passed between the
+stages in batches, to keep the cost of the hand over low.
+*/
+class pipeline_item
+{
+	public:
+#define PIPELINE_BATCH_SIZE (64)
+		//infix tokens of every expression of the batch, or the postfix expressions once compiled.
+		vector< vector< token_t > > expressions;
+		//OP_INVALID for expressions which could not be compiled.
+		vector< token_t > status;
+		//script lines the expressions start on.
+		vector< uint32_t > lines;
+		//the script commands given instead of expressions, or NULL.
+		vector< const char* > commands;
+};
+
+class pipeline
+{
+	public:
+#define PIPELINE_QUEUE_SIZE (64) //batches
+		pipeline(FILE* f) : file(f), tokenized(PIPELINE_QUEUE_SIZE), compiled(PIPELINE_QUEUE_SIZE) {}
+#undef PIPELINE_QUEUE_SIZE
+
+		void run(symboltable& st);
+
+	private:
+		FILE* file;
+
+		//NULL marks the end of the script.
+		spsc_queue< pipeline_item* > tokenized;
+		spsc_queue< pipeline_item* > compiled;
+
+		static void* read_expressions(void* arg);
+		static void* compile_expressions(void* arg);
+};
+
+void* pipeline::read_expressions(void* arg)
+{
+	pipeline* p = (pipeline*) arg;
+	stream_reader r(p->file);
+
+	bool end = false;
+	while(!end)
+	{
+		pipeline_item* item = new pipeline_item();
+		item->expressions.reserve(PIPELINE_BATCH_SIZE);
+		item->status.reserve(PIPELINE_BATCH_SIZE);
+		while(item->expressions.size() < PIPELINE_BATCH_SIZE)
+		{
+			if(r.at_end() || r.read_command("quit"))
+			{
+				end = true;
+				break;
+			}
+			item->expressions.push_back(vector< token_t >());
+			item->commands.push_back(read_script_command(r));
+			if(item->commands.back())
+			{
+				item->status.push_back(token_t());
+				item->status.back().type = OP_EOF;
+				item->lines.push_back(r.expression_line);
+				continue;
+			}
+			item->status.push_back(tokenize_infix(r, item->expressions.back()));
+			item->lines.push_back(r.expression_line);
+			r.end_expression();
+		}
+		p->tokenized.push(item);
+	}
+	p->tokenized.push(NULL);
+	return NULL;
+}
+
+void* pipeline::compile_expressions(void* arg)
+{
+	pipeline* p = (pipeline*) arg;
+	pipeline_item* item;
+
+	while((item = p->tokenized.pop()) != NULL)
+	{
+		for(int i = 0; i < item->expressions.size(); ++i)
+		{
+			if(item->status[i].type == OP_INVALID || item->commands[i])
+				continue;
+			profile_here.line = item->lines[i];
+			vector< token_t > postfix;
+			item->status[i] = infix_to_postfix(item->expressions[i], postfix);
+			item->expressions[i].swap(postfix);
+		}
+		p->compiled.push(item);
+	}
+	p->compiled.push(NULL);
+	return NULL;
+}
+
+void pipeline::run(symboltable& st)
+{
+	pthread_t reader, compiler;
+	pthread_create(&reader, NULL, pipeline::read_expressions, this);
+	pthread_create(&compiler, NULL, pipeline::compile_expressions, this);
+
+	stack< token_t > s;
+	pipeline_item* item;
+	while((item = compiled.pop()) != NULL)
+	{
+		for(int i = 0; i < item->expressions.size(); ++i)
+		{
+			if(item->commands[i])
+			{
+				run_script_command(item->commands[i], st);
+				continue;
+			}
+			global_read_section section(st);
+			profile_here.line = item->lines[i];
+			token_t t = item->status[i];
+			if(t.type != OP_INVALID)
+				t = evaluate_postfix(item->expressions[i], s, st);
+
+			if(t.type == OP_OBJECT && t.objectp)
+			{
+				t.objectp->print_object();
+				if(t.objectp->get_refcount() == 0)
+					object::object_reap(t.objectp);
+			}
+			else
+				print_token(t);
+		}
+		delete item;
+	}
+
+	pthread_join(compiler, NULL);
+	pthread_join(reader, NULL);
+}
+
+/*
+Cooperative scheduler. Tasks run in slices on a pool of worker threads: a worker takes the task at the head of the
+run queue, runs one slice of it, and puts it back at the tail unless it is complete. A heavy task thus holds up the
+others for no longer than a slice. Every task is run by one worker at a time.
+*/
+class task
+{
+	public:
+		virtual ~task() {}
+
+		//runs one slice of the task. returns true once the task is complete.
+		virtual bool run_slice() = 0;
+};
+
+class scheduler
+{
+	public:
+		//called on a worker thread for every task that completes.
+		typedef void (*completion_t)(task* t, void* arg);
+
+		scheduler(completion_t c, void* a) : completion(c), arg(a), stopping(false)
+		{
+			pthread_mutex_init(&lock, NULL);
+			pthread_cond_init(&runnable, NULL);
 		}
-		t->varname[i] = '\0';
-		istream = --r;
+		~scheduler()
+		{
+			stop();
+			pthread_cond_destroy(&runnable);
+			pthread_mutex_destroy(&lock);
+		}
+
+		void start(int threads);
+
+		//waits for the running slices to finish. tasks left in the run queue are dropped.
+		void stop();
+
+		void submit(task* t);
+
+	private:
+		completion_t completion;
+		void* arg;
+
+		deque< task* > run_queue;
+		vector< pthread_t > workers;
+		bool stopping;
+
+		pthread_mutex_t lock;
+		pthread_cond_t runnable;
+
+		static void* worker(void* arg);
+};
+
+void scheduler::start(int threads)
+{
+	workers.resize(threads);
+	for(int i = 0; i < threads; ++i)
+		pthread_create(&workers[i], NULL, scheduler::worker, this);
+}
+
+void scheduler::stop()
+{
+	pthread_mutex_lock(&lock);
+	stopping = true;
+	pthread_cond_broadcast(&runnable);
+	pthread_mutex_unlock(&lock);
+
+	for(int i = 0; i < workers.size(); ++i)
+		pthread_join(workers[i], NULL);
+	workers.clear();
+}
+
+void scheduler::submit(task* t)
+{
+	pthread_mutex_lock(&lock);
+	run_queue.push_back(t);
+	pthread_cond_signal(&runnable);
+	pthread_mutex_unlock(&lock);
+}
+
+void* scheduler::worker(void* arg)
+{
+	scheduler* sched = (scheduler*) arg;
+
+	pthread_mutex_lock(&sched->lock);
+	while(true)
+	{
+		while(sched->run_queue.empty() && !sched->stopping)
+			pthread_cond_wait(&sched->runnable, &sched->lock);
+		if(sched->stopping)
+			break;
+
+		task* t = sched->run_queue.front();
+		sched->run_queue.pop_front();
+		pthread_mutex_unlock(&sched->lock);
+
+		bool complete = t->run_slice();
+		if(complete)
+			sched->completion(t, sched->arg);
+
+		pthread_mutex_lock(&sched->lock);
+		if(!complete)
+			sched->run_queue.push_back(t);
 	}
-	
-	//Consume exactly one token from istream and return a pointer from where the next token starts.
-	return ++istream;
+	pthread_mutex_unlock(&sched->lock);
+	return NULL;
 }
 
 /*
-Evaluate the well formed postfix expression in the vector v, and populate the result in 'result'.
+Evaluation server.
+Clients connect to a Unix domain socket, or a TCP port on the loopback interface, and every connection is a session
+with a symbol table and an isolate of its own. A request is a frame: a 4 byte length in network byte order followed
+by that many bytes of expressions, one per line. The response is a frame holding one line per expression, with the
+result as printed by the interpreter. Clients may send further requests before the responses arrive; responses are
+sent in the order of the requests.
+The sockets of all sessions are served by a single thread, multiplexed with epoll, while requests are evaluated by
+the workers of a scheduler. A session evaluates one request at a time, in slices, and every expression is held to
+the instruction budget of the server while the objects of a session are held to its memory budget.
 */
-token_t evaluate_postfix(const vector< token_t > &v, stack< token_t> &s, symboltable& st)
+#define SESSION_MAX_OUTPUT (16 * 1024 * 1024)
+class server_session : public task
 {
-#define GET_OBJECT_POINTER(token, object_pointer, reporterror) do { \
-	if(token.type == OP_VARIABLE) \
-	{ \
-		if(!st.get_symbol(string(token.varname), object_pointer) && reporterror) \
-		{ \
-			err.error_code = ERROR_UNDEFINED_VARIABLE; \
-			goto cleanup_and_return_error; \
-		} \
-	} \
-	else if(token.type == OP_OBJECT) \
-		object_pointer = token.objectp; \
-} while(0)
+	public:
+		int fd;
+		isolate heap;
+		symboltable st;
 
-#define RETURN_IF_NULL(x) do { \
-	if(x == NULL) \
-	{ \
-		err.error_code = ERROR_UNDEFINED_OPERATOR; \
-		goto cleanup_and_return_error; \
-	} \
-} while(0)
+		//owned by the thread running the event loop.
+		string input;   //bytes received, which do not form a complete request yet.
+		string output;  //responses not sent yet.
+		size_t sent;    //bytes of output sent so far.
+		uint32_t events; //the session waits for these events of its socket.
+		deque< string > requests; //requests waiting for the one being evaluated.
+		bool busy;      //a request is being evaluated.
+		bool closing;   //the connection was closed, the session is deleted once it is not busy any more.
 
-#define RETURN_IF_EMPTY do { \
-	if(s.empty()) \
-	{ \
-		err.error_code = ERROR_UNEXPECTED_END_OF_EXPRESSION; \
-		goto cleanup_and_return_error; \
-	} \
-} while(0)
+		//owned by the worker evaluating the request.
+		string request;
+		size_t offset;  //the expressions of the request before offset have been evaluated.
+		string response;
+		size_t instruction_budget;
+		size_t memory_budget;
 
-	token_t err;
-	err.type = OP_INVALID;
+		server_session(int s, size_t instructions, size_t memory) : fd(s), sent(0), events(EPOLLIN), busy(false),
+			closing(false), offset(0), instruction_budget(instructions), memory_budget(memory), evaluating(false) {}
+		~server_session()
+		{
+			isolate_scope scope(&heap);
+			release_postfix(postfix);
+			st.clear();
+		}
 
-	int i, j;
-	for(i = 0; i < v.size(); ++i)
+		bool run_slice();
+
+		//while the client leaves more than SESSION_MAX_OUTPUT bytes of responses unread, the session neither
+		//reads nor evaluates requests.
+		bool backlogged() const { return output.size() - sent > SESSION_MAX_OUTPUT; }
+
+	private:
+#define SESSION_SLICE (10000) //operators evaluated in one slice.
+		//the expression being evaluated.
+		vector< token_t > postfix;
+		stack< token_t > operands;
+		evaluation_control control;
+		bool evaluating;
+
+		void respond(const token_t& t);
+};
+
+bool server_session::run_slice()
+{
+	isolate_scope scope(&heap);
+	global_read_section section(st);
+
+	control.slice = SESSION_SLICE;
+	while(control.slice > 0)
 	{
-		if(v[i].type == OP_OBJECT || v[i].type == OP_VARIABLE)
-			s.push(v[i]);
-		else if(is_evaluation_operator(v[i].type))
+		if(!evaluating)
 		{
-			//Evaluate the expression (operator op) for unary operators.
-			if(is_unary_operator(v[i].type))
+			if(offset >= request.size())
+				return true;
+
+			size_t eol = request.find('\n', offset);
+			if(eol == string::npos)
+				eol = request.size();
+			string expression(request, offset, eol - offset);
+			offset = eol + 1;
+
+			token_t t = compile_infix(expression.c_str(), postfix);
+			if(t.type == OP_INVALID)
 			{
-				RETURN_IF_EMPTY;
-				token_t op = s.top();
-				s.pop();
-				object_pointer_t p = NULL, r;
-				GET_OBJECT_POINTER(op, p, true);
-				switch(v[i].type)
-				{
-					case OP_BITWISE_NOT: r = ~(*p); break;
-				}
-				token_t result;
-				result.type = OP_OBJECT;
-				RETURN_IF_NULL(r);
-				result.objectp = r;
-				s.push(result);
-				if(op.type == OP_OBJECT) object::object_reap(p);
+				release_postfix(postfix);
+				respond(t);
 				continue;
 			}
+			heap.set_budget(instruction_budget, memory_budget);
+			control.position = 0;
+			evaluating = true;
+		}
 
-			//Evaluate the expression (op1 operator op2) for a binary operators.
-			RETURN_IF_EMPTY;
-			token_t op2 = s.top();
-			s.pop();
-			RETURN_IF_EMPTY;
-			token_t op1 = s.top();
-			s.pop();
-			
-			object_pointer_t p1 = NULL, p2 = NULL, r = NULL;
+		token_t t = evaluate_postfix(postfix, operands, st, &control);
+		if(control.suspended)
+			return false;
 
-			//For assignment op1 need not already be a defined variable.
-			if(v[i].type == OP_ASSIGN)
-				GET_OBJECT_POINTER(op1, p1, false);
-			else
-				GET_OBJECT_POINTER(op1, p1, true);
+		evaluating = false;
+		postfix.clear();
+		respond(t);
+	}
+	return offset >= request.size() && !evaluating;
+}
 
-			GET_OBJECT_POINTER(op2, p2, true);
+void server_session::respond(const token_t& t)
+{
+	if(t.type == OP_OBJECT && t.objectp)
+	{
+		value_formatter f;
+		f.write_object(t.objectp);
+		f.write('\n');
+		response.append(f.data(), f.length());
+		//results which are not stored in a variable are not needed any more.
+		if(t.objectp->get_refcount() == 0)
+			object::object_reap(t.objectp);
+		return;
+	}
 
-			switch(v[i].type)
-			{
-				case OP_ADD: 		r = *p1 + *p2 ; break;
-				case OP_SUBTRACT: 	r = *p1 - *p2 ; break;
-				case OP_MULTIPLY: 	r = *p1 * *p2 ; break;
-				case OP_DIVIDE: 	r = *p1 / *p2 ; break;
-				case OP_MODULO: 	r = *p1 % *p2 ; break;
-				case OP_BITWISE_AND: 	r = *p1 & *p2 ; break;
-				case OP_BITWISE_OR: 	r = *p1 | *p2 ; break;
-				case OP_BITWISE_XOR: 	r = *p1 ^ *p2 ; break;
-				case OP_ASSIGN:
-				//op1 should be a variable, otherwise generate an error.
-				if(op1.type != OP_VARIABLE)
-				{
-					err.error_code = ERROR_ASSIGNMENT_TO_CONSTANT;
-					s.push(op1); s.push(op2);			
-					goto cleanup_and_return_error;
-				}
-				string lvalue(op1.varname);
-				st.set_symbol(lvalue, p2);
-				if(p2) p2->increment_refcount();
-				if(p1) p1->decrement_refcount();
-				r = p2;
-			}
-			token_t result;
-			result.type = OP_OBJECT;
-			RETURN_IF_NULL(r);
-			result.objectp = r;
-			s.push(result);
+	char* text = NULL;
+	size_t length = 0;
+	FILE* out = open_memstream(&text, &length);
+	print_token(t, out);
+	fclose(out);
 
-			//If objects used in the expression are constants, we can release them.
-			if(v[i].type != OP_ASSIGN)
-			{
-				if(op1.type == OP_OBJECT) object::object_reap(p1);
-				if(op2.type == OP_OBJECT) object::object_reap(p2);
-			}
-		}
-		else
-		{
-			err.error_code = ERROR_BAD_EXPRESSION;
-			goto cleanup_and_return_error;
-		}
-		j = i; //Processing is complete upto j. In case of error in next iteration, the cleanup code examines the vector from j.
+	response.append(text, length);
+	free(text);
+}
+
+#undef SESSION_SLICE
+#undef SESSION_MAX_OUTPUT
+
+class server
+{
+	public:
+		//every session caches the results of up to cache expressions, if cache is not 0.
+		server(int workers, size_t instructions, size_t memory, size_t cache = 0);
+		~server();
+
+		//address is either the path of a Unix domain socket, or [127.0.0.1|localhost]:port. an existing file at the
+		//path is replaced only if it is a socket.
+		bool listen_on(const char* address);
+		void run();
+
+	private:
+#define SERVER_MAX_REQUEST (64 * 1024 * 1024)
+#define SERVER_MAX_EVENTS (256)
+		int listener;
+		int epoll;
+		string unix_path;
+		map< int, server_session* > sessions;
+
+		scheduler sched;
+		int workers;
+		size_t instruction_budget;
+		size_t memory_budget;
+		size_t cache_entries;
+
+		//sessions whose request has been evaluated. workers signal the event loop through an eventfd.
+		int completion_event;
+		pthread_mutex_t completion_lock;
+		vector< server_session* > completed;
+
+		//sessions closed while handling a batch of events, which later events of the batch may still refer to.
+		//they are deleted after the batch.
+		vector< server_session* > closed;
+
+		void accept_sessions();
+		bool receive(server_session* s);
+		bool send_pending(server_session* s);
+		void start_request(server_session* s);
+		void resume(server_session* s);
+		void finish_requests();
+		void watch(server_session* s, bool writable);
+		void close_session(server_session* s);
+
+		static void request_completed(task* t, void* arg);
+};
+
+//the descriptors without a session are told apart by these markers.
+static char listener_marker, completion_marker;
+
+server::server(int worker_count, size_t instructions, size_t memory, size_t cache) : listener(-1), epoll(-1),
+	sched(server::request_completed, this), workers(worker_count), instruction_budget(instructions),
+	memory_budget(memory), cache_entries(cache), completion_event(-1)
+{
+	pthread_mutex_init(&completion_lock, NULL);
+}
+
+server::~server()
+{
+	sched.stop();
+	if(completion_event >= 0)
+		close(completion_event);
+	pthread_mutex_destroy(&completion_lock);
+
+	map< int, server_session* >::iterator i;
+	for(i = sessions.begin(); i != sessions.end(); ++i)
+	{
+		close((*i).first);
+		delete (*i).second;
 	}
-	
-	//The stack should have had exactly one element after completion of evaluation.
-	if(s.size() != 1)
-		err.error_code = ERROR_BAD_EXPRESSION;
-	else
+	if(listener >= 0)
+		close(listener);
+	if(epoll >= 0)
+		close(epoll);
+	if(!unix_path.empty())
+		unlink(unix_path.c_str());
+}
+
+bool server::listen_on(const char* address)
+{
+	const char* colon = strrchr(address, ':');
+	if(colon && strchr(address, '/') == NULL)
 	{
-		token_t res = s.top(); //No errors detected during evaluation.
-		s.pop();
-		object_pointer_t p = NULL;
-		GET_OBJECT_POINTER(res, p, true);
-		res.type = OP_OBJECT;
-		res.objectp = p;
-		return res;
+		struct sockaddr_in sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sin_family = AF_INET;
+		sa.sin_port = htons(atoi(colon + 1));
+		sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		//sessions may read the variables of the prelude, so they are served to the machine itself only.
+		string host(address, colon - address);
+		if(!host.empty() && host != "127.0.0.1" && host != "localhost")
+			return false;
+
+		int on = 1;
+		listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+		if(listener < 0)
+			return false;
+		setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		if(bind(listener, (struct sockaddr*) &sa, sizeof(sa)) < 0)
+			return false;
 	}
-	
-cleanup_and_return_error:
-	for( ++j ; j < v.size(); ++j)
+	else
 	{
-		if(v[j].type == OP_OBJECT)
+		struct sockaddr_un sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sun_family = AF_UNIX;
+		if(strlen(address) >= sizeof(sa.sun_path))
+			return false;
+		strcpy(sa.sun_path, address);
+
+		//a socket left behind by an earlier server is replaced, any other file is not.
+		struct stat st;
+		if(lstat(address, &st) == 0)
 		{
-			object_pointer_t p = NULL;
-			GET_OBJECT_POINTER(v[j], p, true);
-			object::object_reap(p);
+			if(!S_ISSOCK(st.st_mode) || unlink(address) < 0)
+				return false;
 		}
+
+		listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+		if(listener < 0)
+			return false;
+		if(bind(listener, (struct sockaddr*) &sa, sizeof(sa)) < 0)
+			return false;
+		unix_path = address;
 	}
-	while(!s.empty())
+
+	if(listen(listener, SOMAXCONN) < 0)
+		return false;
+
+	epoll = epoll_create1(0);
+	if(epoll < 0)
+		return false;
+
+	struct epoll_event e;
+	e.events = EPOLLIN;
+	e.data.ptr = &listener_marker;
+	if(epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &e) < 0)
+		return false;
+
+	completion_event = eventfd(0, EFD_NONBLOCK);
+	e.data.ptr = &completion_marker;
+	if(completion_event < 0 || epoll_ctl(epoll, EPOLL_CTL_ADD, completion_event, &e) < 0)
+		return false;
+
+	sched.start(workers);
+	return true;
+}
+
+//set by SIGINT and SIGTERM, to shut the server down cleanly.
+static volatile sig_atomic_t server_stop = 0;
+
+static void stop_server(int)
+{
+	server_stop = 1;
+}
+
+void server::run()
+{
+	struct epoll_event events[SERVER_MAX_EVENTS];
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = stop_server;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	while(!server_stop)
 	{
-		token_t t = s.top();
-		s.pop();
-		if(t.type == OP_OBJECT)
+		int n = epoll_wait(epoll, events, SERVER_MAX_EVENTS, -1);
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n < 0)
+			break;
+
+		for(int i = 0; i < n; ++i)
 		{
-			object_pointer_t p = NULL;
-			GET_OBJECT_POINTER(t, p, true);
-			object::object_reap(p);
+			if(events[i].data.ptr == &listener_marker)
+			{
+				accept_sessions();
+				continue;
+			}
+			if(events[i].data.ptr == &completion_marker)
+			{
+				finish_requests();
+				continue;
+			}
+
+			server_session* s = (server_session*) events[i].data.ptr;
+			if(s->closing)
+				continue;
+			bool ok = true;
+			if(events[i].events & (EPOLLERR | EPOLLHUP))
+				ok = (events[i].events & EPOLLIN) != 0;
+			if(ok && (events[i].events & EPOLLIN))
+				ok = receive(s);
+			if(ok && !s->output.empty())
+				ok = send_pending(s);
+			if(!ok)
+				close_session(s);
 		}
+
+		for(int i = 0; i < closed.size(); ++i)
+			delete closed[i];
+		closed.clear();
 	}
+}
 
-	return err;
+void server::accept_sessions()
+{
+	while(true)
+	{
+		int fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK);
+		if(fd < 0)
+			return;
 
-#undef RETURN_IF_EMPTY
-#undef RETURN_IF_NULL
-#undef GET_OBJECT_POINTER
+		server_session* s = new server_session(fd, instruction_budget, memory_budget);
+		s->st.attach_global(&globals);
+		s->st.enable_cache(cache_entries);
+		sessions[fd] = s;
+
+		struct epoll_event e;
+		e.events = EPOLLIN;
+		e.data.ptr = s;
+		epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &e);
+	}
 }
 
-/*
-Assign a priority value for each operator.
-*/
-int priority_value(operator_t x)
+//read what is available, and evaluate all complete requests. returns false if the session has to be closed.
+bool server::receive(server_session* s)
 {
-	switch(x)
+	char buffer[64 * 1024];
+	bool closed = false;
+
+	while(true)
 	{
-		case OP_ADD :
-		case OP_SUBTRACT : return 0;
-		
-		case OP_MULTIPLY :
-		case OP_DIVIDE : return 5;
+		ssize_t n = read(s->fd, buffer, sizeof(buffer));
+		if(n > 0)
+			s->input.append(buffer, n);
+		else if(n < 0 && errno == EINTR)
+			continue;
+		else
+		{
+			closed = (n == 0 || errno != EAGAIN);
+			break;
+		}
+	}
 
-		case OP_BITWISE_AND:
-		case OP_BITWISE_OR:
-		case OP_BITWISE_XOR: return 0;
-		case OP_BITWISE_NOT: return 10;
+	size_t offset = 0;
+	while(s->input.size() - offset >= 4)
+	{
+		const unsigned char* h = (const unsigned char*) s->input.data() + offset;
+		size_t length = ((size_t) h[0] << 24) | (h[1] << 16) | (h[2] << 8) | h[3];
+		if(length > SERVER_MAX_REQUEST)
+			return false;
+		if(s->input.size() - offset - 4 < length)
+			break;
 
-		case OP_ASSIGN : return -5;
+		s->requests.push_back(string(s->input, offset + 4, length));
+		offset += 4 + length;
 	}
-	return 0;
+	s->input.erase(0, offset);
+
+	resume(s);
+
+	if(closed)
+	{
+		//the client has closed its end, send what the socket accepts of the remaining responses.
+		send_pending(s);
+		return false;
+	}
+	return true;
 }
 
-/*
-Return
-1: If operator x is of higher priority than operator y.
-0: x and y are of same priority.
--1: If operator y is of higher priority than operator x.
-*/
-int is_higher_priority(operator_t x, operator_t y)
+//start the next request of the session, unless one is being evaluated or the client is not reading the responses.
+void server::resume(server_session* s)
 {
-	int i = priority_value(x) - priority_value(y);
-
-	//Operators such as = have to be evaluated from right to left.
-	if(x == OP_ASSIGN && y == OP_ASSIGN)
-		return -1;
+	if(!s->busy && !s->requests.empty() && !s->backlogged())
+		start_request(s);
+}
 
-	return (i > 0) ? 1 : (i == 0 ? 0 : -1);
+void server::start_request(server_session* s)
+{
+	s->request.swap(s->requests.front());
+	s->requests.pop_front();
+	s->offset = 0;
+	s->response.clear();
+	s->busy = true;
+	sched.submit(s);
 }
 
-/*
-Evaluate the infix expression pointed by p.
-*/
-token_t evaluate_infix(const char* p, symboltable& st)
+void server::request_completed(task* t, void* arg)
 {
-#define POP_ALL do { \
-	while(!s.empty()) \
-	{ \
-		token_t top = s.top(); \
-		if(top.type != OP_OPEN_SCOPE) \
-			v.push_back(top); \
-		s.pop(); \
-	} \
-} while(0)
+	server* srv = (server*) arg;
+	uint64_t one = 1;
 
-#define POP_AND_POPULATE_VECTOR do { \
-	while(!s.empty()) \
-	{ \
-		token_t top = s.top(); \
-		if(top.type == OP_OPEN_SCOPE) break; \
-		v.push_back(top); \
-		s.pop(); \
-	} \
-} while(0)
+	pthread_mutex_lock(&srv->completion_lock);
+	srv->completed.push_back((server_session*) t);
+	pthread_mutex_unlock(&srv->completion_lock);
 
-#define POP_HIGH_PRIORITY_AND_POPULATE_VECTOR do { \
-	while(!s.empty()) \
-	{ \
-		token_t top = s.top(); \
-		if(top.type == OP_OPEN_SCOPE) break; \
-		if(is_higher_priority(top.type, t.type) < 0) break; \
-		v.push_back(top); \
-		s.pop(); \
-	} \
-} while(0)
+	ssize_t written;
+	do
+		written = write(srv->completion_event, &one, sizeof(one));
+	while(written < 0 && errno == EINTR);
+	(void) written; //fails with EAGAIN if the counter is saturated, the event loop is going to wake up anyway.
+}
 
-	stack < token_t > s; //Used for conversion from infix to postfix.
-	vector< token_t > v; //Vector that stores the postfix expression.
+//send the responses of the evaluated requests, and start the next requests of their sessions.
+void server::finish_requests()
+{
+	uint64_t n;
+	vector< server_session* > done;
 
-	token_t t;
-	const char* q;
+	ssize_t cleared;
+	do
+		cleared = read(completion_event, &n, sizeof(n));
+	while(cleared < 0 && errno == EINTR);
+	(void) cleared; //fails with EAGAIN if there is nothing to clear.
 
-	t.type = OP_INVALID;
-	if(p == NULL) return t;
+	pthread_mutex_lock(&completion_lock);
+	done.swap(completed);
+	pthread_mutex_unlock(&completion_lock);
 
-	while(p)
+	for(int i = 0; i < done.size(); ++i)
 	{
-		q = get_next_token(p, &t);
-		
-		switch(t.type)
+		server_session* s = done[i];
+		s->busy = false;
+		if(s->closing)
 		{
-			case OP_OBJECT:
-			case OP_VARIABLE:
-				v.push_back(t);
-				break;
+			closed.push_back(s);
+			continue;
+		}
 
-			//incoming opening brace. read the token stream until OP_CLOSE_BRACE is received, and create a list
-			//object if successful. otherwise report error.
-			case OP_OPEN_BRACE:
-			{
-				object_pointer_t list = object::create_object(OBJECT_LIST);
-				do
-				{
-					q = get_next_token(q, &t);
-					switch(t.type)
-					{
-						case OP_OBJECT: object::add_object_to_list(list, t.objectp); break;
-						case OP_SEPARATOR: break;
-						case OP_CLOSE_BRACE:
-							t.type = OP_OBJECT;
-							t.objectp = list;
-							v.push_back(t);
-							goto last_statement_main_loop;
-					}
-				} while(q);
-			}
-			case OP_ADD:
-			case OP_SUBTRACT:
-			case OP_MULTIPLY:
-			case OP_DIVIDE:
-			case OP_MODULO:
-			case OP_ASSIGN:
-			case OP_BITWISE_AND:
-			case OP_BITWISE_OR:
-			case OP_BITWISE_XOR:
-			case OP_BITWISE_NOT:
-			//incoming operator; pop operators from the stack which are of higher priority, put them into the vector and then push
-			//this element into the stack.
-				POP_HIGH_PRIORITY_AND_POPULATE_VECTOR;
-				s.push(t); break;
-			case OP_OPEN_SCOPE:
-				s.push(t); break;
-			case OP_CLOSE_SCOPE:
-			//pop operators from the stack and put them into the vector until an OP_OPEN_SCOPE type is removed.
-				POP_AND_POPULATE_VECTOR;
-				break;
-			case OP_EOF: goto evaluate_expression;
-			case OP_INVALID: return t;
+		size_t length = s->response.size();
+		unsigned char h[4] = { (unsigned char) (length >> 24), (unsigned char) (length >> 16),
+			(unsigned char) (length >> 8), (unsigned char) length };
+		s->output.append((const char*) h, 4);
+		s->output.append(s->response);
+		s->response.clear();
+
+		if(!send_pending(s))
+			close_session(s);
+		else
+			resume(s);
+	}
+}
+
+//write as much of the pending output as the socket accepts. returns false if the session has to be closed.
+bool server::send_pending(server_session* s)
+{
+	while(s->sent < s->output.size())
+	{
+		ssize_t n = send(s->fd, s->output.data() + s->sent, s->output.size() - s->sent, MSG_NOSIGNAL);
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n < 0 && errno == EAGAIN)
+		{
+			watch(s, true);
+			resume(s);
+			return true;
 		}
-last_statement_main_loop:
-		p = q;
+		if(n <= 0)
+			return false;
+		s->sent += n;
 	}
-evaluate_expression:
-	POP_ALL;
+	s->output.clear();
+	s->sent = 0;
+	watch(s, false);
+	resume(s);
+	return true;
+}
 
-	return evaluate_postfix(v, s, st);
+//a backlogged session is not read from, so that a client which does not read its responses cannot make the server
+//buffer them without bounds.
+void server::watch(server_session* s, bool writable)
+{
+	uint32_t events = (s->backlogged() ? 0 : (uint32_t) EPOLLIN) | (writable ? (uint32_t) EPOLLOUT : 0);
+	if(s->events == events)
+		return;
+	s->events = events;
 
-#undef POP_HIGH_PRIORITY_AND_POPULATE_VECTOR
-#undef POP_AND_POPULATE_VECTOR
-#undef POP_ALL
+	struct epoll_event e;
+	e.events = events;
+	e.data.ptr = s;
+	epoll_ctl(epoll, EPOLL_CTL_MOD, s->fd, &e);
 }
 
-void run_testcases_from_file(FILE* file, symboltable& st)
+void server::close_session(server_session* s)
 {
-	char expr[128], expected_result[128], result[128];
-	int i = 0, p = 0;
-	
-#define REMOVE_TRAILING_NEWLINE(s) do { \
-if(s[strlen(s) - 1] == '\n') \
-	s[strlen(s) - 1] = '\0'; \
-} while(0)
-	
-	while(fgets(expr, sizeof(expr), file))
-	{
-		REMOVE_TRAILING_NEWLINE(expr);
-		
-		if(!strcmp(expr, "quit"))
-			break;
-		token_t t = evaluate_infix(expr, st);
-		fgets(expected_result, sizeof(expected_result), file);
+	epoll_ctl(epoll, EPOLL_CTL_DEL, s->fd, NULL);
+	close(s->fd);
+	sessions.erase(s->fd);
+
+	//a session being evaluated is deleted once its request completes.
+	s->closing = true;
+	if(!s->busy)
+		closed.push_back(s);
+}
 
-		REMOVE_TRAILING_NEWLINE(expected_result);
+#undef SERVER_MAX_EVENTS
+#undef SERVER_MAX_REQUEST
 
-		if(t.type == OP_OBJECT && t.objectp)
-		{
-			object::debug_string(t.objectp, result, sizeof(result));
+/*
+Evaluate the prelude script file into the symbol table prelude, printing errors only.
+*/
+bool run_prelude(const char* name, symboltable& prelude)
+{
+	FILE* file = fopen(name, "r");
+	if(file == NULL)
+		return false;
 
-			if(!strcmp(expected_result, result))
-				++p, printf("test case [%s] *PASS*\n", expr);
-			else
-				printf("test case [%s] expected [%s] obtained [%s] *FAIL*\n", expr, expected_result, result);
+	stream_reader r(file);
+	while(!r.at_end())
+	{
+		token_t t = evaluate_infix(r, prelude);
+		r.end_expression();
+		if(t.type != OP_OBJECT)
+			print_token(t);
+		else if(t.objectp->get_refcount() == 0)
+			object::object_reap(t.objectp);
+	}
+	fclose(file);
+	return true;
+}
+
+/*
+Make the symbols of a prelude global. The prelude is either a script, whose symbols are moved to the global symbol
+table, or a snapshot, which is mapped beneath the global symbol table.
+*/
+bool load_prelude(const char* name)
+{
+	if(snapshot_image::is_snapshot(name))
+	{
+		const char* error;
+		snapshot_image* image = snapshot_image::open(name, &error);
+		if(image == NULL)
+		{
+			printf("%s: %s\n", name, error);
+			return false;
 		}
-		++i;		
+		globals.attach_image(image);
+		return true;
 	}
-	printf("total test cases=%d passed=%d failed=%d\n", i, p, i-p);
 
-#undef REMOVE_TRAILING_NEWLINE
+	symboltable prelude;
+	if(!run_prelude(name, prelude))
+		return false;
+	globals.publish(prelude);
+	return true;
 }
 
-const char prompt[] = "neo] ";
-
 int main(int argv, char** argc)
 {
-	char buffer[128];
 	symboltable st;
 
 	FILE* file = NULL;
 
-	if(argv == 2)
+	//-t file traces the whole run and writes the trace to file on exit, before any other option.
+	if(argv >= 3 && !strcmp(argc[1], "-t"))
 	{
-		file = fopen(argc[1], "r");
+		trace_file = argc[2];
+		tracer::start();
+		atexit(write_trace_at_exit);
+		argv -= 2;
+		argc += 2;
+	}
+
+	//-P profiles the run and prints a report to stderr on exit, after -t and before any other option.
+	if(argv >= 2 && !strcmp(argc[1], "-P"))
+	{
+		if(!profiler::start())
+		{
+			printf("cannot start the profiler\n");
+			return -1;
+		}
+		atexit(print_profile_at_exit);
+		argv -= 1;
+		argc += 1;
+	}
+
+	//-d prints floats with 2 decimals rather than as the shortest text which reads back as the same value, after -P and
+	//before any other option.
+	if(argv >= 2 && !strcmp(argc[1], "-d"))
+	{
+		value_formatter::float_format = value_formatter::FLOAT_FIXED;
+		argv -= 1;
+		argc += 1;
+	}
+
+	//-g prelude evaluates a script, or maps a snapshot, whose variables are made global, before any other option.
+	if(argv >= 3 && !strcmp(argc[1], "-g"))
+	{
+		if(!load_prelude(argc[2]))
+		{
+			printf("cannot load prelude %s\n", argc[2]);
+			return -1;
+		}
+		st.attach_global(&globals);
+		argv -= 2;
+		argc += 2;
+	}
+
+	//-M entries caches the results of pure expressions, after -g and before any other option.
+	size_t cache_entries = 0;
+	if(argv >= 3 && !strcmp(argc[1], "-M"))
+	{
+		cache_entries = strtoul(argc[2], NULL, 10);
+		st.enable_cache(cache_entries);
+		argv -= 2;
+		argc += 2;
+	}
+
+	//-j[threads] evaluates the independent statements of a script in parallel, on all cores by default.
+	if(argv == 3 && !strncmp(argc[1], "-j", 2))
+	{
+		int threads = atoi(argc[1] + 2);
+		if(threads <= 0)
+			threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+		file = fopen(argc[2], "r");
 		if(file == NULL)
 		{
-			printf("cannot open file %s\n", argc[1]);
+			printf("cannot open file %s\n", argc[2]);
 			return -1;
 		}
-		run_testcases_from_file(file, st);
+		//the cache is not shared by threads.
+		st.enable_cache(0);
+		run_script_in_parallel(file, st, threads);
 		fclose(file);
 	}
-	else
+	//-s address serves sessions on a socket, optionally followed by
+	//-w workers, -i instruction budget of an expression, -m memory budget of a session in bytes.
+	else if(argv >= 3 && argv % 2 == 1 && !strcmp(argc[1], "-s"))
 	{
-		printf("%s", prompt);
-		while(gets(buffer))
+		//clients must not read the files of the server. a prelude may have loaded data for them already.
+		loading_allowed = false;
+		int workers = sysconf(_SC_NPROCESSORS_ONLN);
+		size_t instructions = 0, memory = 0;
+		for(int i = 3; i < argv; i += 2)
 		{
-			token_t t;
-			if(!strcmp(buffer, "quit"))
-				break;
-			if(!strcmp(buffer, "m"))
-			{
-				object::print_memory_stats();
-				goto skip_to_last;
-			}
-			t = evaluate_infix(buffer, st);
-			if(t.type == OP_OBJECT && t.objectp)	
-#ifdef DEBUG_NEO
-				t.objectp->print_object(true);
-#else	
-				t.objectp->print_object();
-#endif
-			else
-				print_token(t);
-skip_to_last:
-			printf("%s", prompt);
+			if(!strcmp(argc[i], "-w"))
+				workers = atoi(argc[i + 1]);
+			else if(!strcmp(argc[i], "-i"))
+				instructions = strtoul(argc[i + 1], NULL, 10);
+			else if(!strcmp(argc[i], "-m"))
+				memory = strtoul(argc[i + 1], NULL, 10);
 		}
-		printf("\n");
+
+		server srv(workers > 0 ? workers : 1, instructions, memory, cache_entries);
+		if(!srv.listen_on(argc[2]))
+		{
+			printf("cannot listen on %s\n", argc[2]);
+			return -1;
+		}
+		srv.run();
 	}
+	//-c prelude snapshot evaluates a script and writes its variables to a snapshot, for use with -g.
+	else if(argv == 4 && !strcmp(argc[1], "-c"))
+	{
+		if(!run_prelude(argc[2], st))
+		{
+			printf("cannot open file %s\n", argc[2]);
+			return -1;
+		}
+		if(!write_snapshot(st, argc[3]))
+		{
+			printf("cannot write snapshot %s\n", argc[3]);
+			return -1;
+		}
+	}
+	//-p evaluates a script, tokenizing and compiling expressions on threads of their own.
+	else if(argv == 3 && !strcmp(argc[1], "-p"))
+	{
+		file = strcmp(argc[2], "-") ? fopen(argc[2], "r") : stdin;
+		if(file == NULL)
+		{
+			printf("cannot open file %s\n", argc[2]);
+			return -1;
+		}
+		pipeline p(file);
+		p.run(st);
+		if(file != stdin)
+			fclose(file);
+	}
+	//-f evaluates a script, or stdin if the file name is -, reading it in chunks.
+	else if(argv == 3 && !strcmp(argc[1], "-f"))
+	{
+		file = strcmp(argc[2], "-") ? fopen(argc[2], "r") : stdin;
+		if(file == NULL)
+		{
+			printf("cannot open file %s\n", argc[2]);
+			return -1;
+		}
+		run_from_stream(file, st, false);
+		if(file != stdin)
+			fclose(file);
+	}
+	else if(argv == 2)
+	{
+		file = fopen(argc[1], "r");
+		if(file == NULL)
+		{
+			printf("cannot open file %s\n", argc[1]);
+			return -1;
+		}
+		run_testcases_from_file(file, st);
+		fclose(file);
+	}
+	else
+		run_from_stream(stdin, st, true);
 
 	return 0;
 }
+#endif
@@ -0,0 +1,120 @@
+/*
+libneo: embeds the neo interpreter in a host process.
+
+A neo_context owns a symbol table and a heap (isolate), and contexts are independent of each other. Source text is
+compiled once into a neo_program, which can be evaluated any number of times. Evaluation returns a neo_value
+instead of printing it; values must be released with neo_value_release.
+
+A context, its programs and its values may be used by one thread at a time, while different contexts can be used
+by different threads in parallel without any locking. Values passed to neo_define become shared: they may then be
+used by several contexts at once.
+
+Build the library with
+$ g++ -shared -fPIC -fvisibility=hidden -DNEO_LIBRARY neo.cpp -o libneo.so -lpthread
+*/
+#ifndef NEO_H
+#define NEO_H
+
+#include <stddef.h>
+
+#define NEO_API __attribute__((visibility("default")))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct neo_context neo_context;
+typedef struct neo_program neo_program;
+typedef struct neo_value neo_value;
+
+//matches object_type_t.
+typedef enum
+{
+	NEO_INTEGER = 0,
+	NEO_FLOAT = 1,
+	NEO_STRING = 2,
+	NEO_LIST = 3
+} neo_type;
+
+NEO_API neo_context* neo_context_create(void);
+NEO_API void neo_context_destroy(neo_context* ctx);
+
+//on failure, NULL is returned and *error (if error is not NULL) points to a static description of the error.
+NEO_API neo_program* neo_compile(neo_context* ctx, const char* source, const char** error);
+NEO_API void neo_program_free(neo_program* program);
+
+NEO_API neo_value* neo_evaluate(neo_context* ctx, const neo_program* program, const char** error);
+
+//compiles and evaluates source in one call.
+NEO_API neo_value* neo_eval(neo_context* ctx, const char* source, const char** error);
+
+//values returned by neo_evaluate and neo_eval stay valid until released, even if the variable they were read from
+//is assigned to again. Values and programs are released into the context they came from, so release them before
+//the context is destroyed, and not while another thread uses the context.
+NEO_API void neo_value_release(neo_value* value);
+
+//binds the variable name of ctx to value, which is marked as shared between contexts. The caller keeps its own
+//reference to value, and no other thread may use value during the call.
+NEO_API void neo_define(neo_context* ctx, const char* name, neo_value* value);
+
+/*
+The global symbol table is shared by all contexts. Symbols not defined in a context are looked up in it, without
+locking, while assignments in a context define symbols of that context only. Updates of the global table copy it,
+so it suits data which is written once and read by many contexts, like constants and lookup tables.
+*/
+
+//binds the global variable name to value, which is marked as shared. The caller keeps its own reference to value.
+NEO_API void neo_global_define(const char* name, neo_value* value);
+
+//moves all variables of ctx to the global symbol table in one update.
+NEO_API void neo_global_publish(neo_context* ctx);
+
+/*
+Caches the results of up to entries expressions evaluated in ctx, evicting the least recently used. An expression
+is cached if it does not assign, bind or load, and its cached result is used for as long as the variables it reads
+keep their values. 0 disables the cache, which is disabled by default. The hits and misses of the cache are part of
+the statistics of ctx.
+*/
+NEO_API void neo_context_cache(neo_context* ctx, size_t entries);
+
+/*
+A snapshot is a binary image of the variables of a context, which is mapped into memory when it is loaded, instead of
+evaluating the script which defined them again. The values of a loaded snapshot are built when they are first looked
+up, and variables of the context hide those of its snapshot. Loading another snapshot into a context replaces the
+previous one; a global snapshot is beneath the global table of every context, and stays loaded until the process
+exits. These functions return 0 on success.
+*/
+NEO_API int neo_snapshot_write(neo_context* ctx, const char* path);
+NEO_API int neo_snapshot_load(neo_context* ctx, const char* path);
+NEO_API int neo_global_load_snapshot(const char* path);
+
+/*
+Writes the statistics of ctx as JSON to buffer, truncated to length bytes including the terminating NUL. These are
+the live and total objects of each type, the bytes in use, the number of times each operator was evaluated and the
+latency percentiles of tokenizing, compiling and evaluating. Returns the length of the whole JSON text, like snprintf.
+*/
+NEO_API size_t neo_context_metrics(neo_context* ctx, char* buffer, size_t length);
+
+/*
+Tracing records spans of tokenizing, compiling, evaluating, cloning and reaping in every thread, and writes them as
+Chrome trace event JSON, which chrome://tracing and Perfetto display as flame charts. Write the trace after stopping
+it; events of threads which are still evaluating at the time may be incomplete. neo_trace_write returns 0 on success.
+*/
+NEO_API void neo_trace_start(void);
+NEO_API void neo_trace_stop(void);
+NEO_API int neo_trace_write(const char* path);
+
+NEO_API neo_type neo_value_type(const neo_value* value);
+NEO_API int neo_value_int(const neo_value* value);
+NEO_API double neo_value_float(const neo_value* value);
+NEO_API const char* neo_value_string(const neo_value* value);
+
+//elements of a list belong to the list and must not be released.
+NEO_API size_t neo_list_length(const neo_value* value);
+NEO_API const neo_value* neo_list_item(const neo_value* value, size_t i);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,125 @@
+/*
+Test cases of libneo, and of scripts run by ./neo, reported like those of the file 'testcase'.
+
+	$ g++ neo.cpp -o neo -lpthread
+	$ g++ -c -DNEO_LIBRARY neo.cpp -o neo.o
+	$ gcc testapi.c neo.o -o testapi -lstdc++ -lpthread
+	$ ./testapi
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "neo.h"
+
+static int cases = 0, passed = 0;
+
+static void check(const char* name, int ok)
+{
+	++cases;
+	if(ok)
+		++passed, printf("test case [%s] *PASS*\n", name);
+	else
+		printf("test case [%s] *FAIL*\n", name);
+}
+
+//neo_define over a name which only the global table defines must leave the global value alone.
+static void define_over_global(void)
+{
+	const char* error;
+	neo_context* publisher = neo_context_create();
+	neo_value_release(neo_eval(publisher, "shared = {1, 2, 3}", &error));
+	neo_global_publish(publisher);
+	neo_context_destroy(publisher);
+
+	neo_context* definer = neo_context_create();
+	neo_value* five = neo_eval(definer, "5", &error);
+	neo_define(definer, "shared", five);
+	neo_value_release(five);
+	neo_value* local = neo_eval(definer, "shared", &error);
+	check("neo_define over a global defines a local", local && neo_value_type(local) == NEO_INTEGER &&
+		neo_value_int(local) == 5);
+	neo_value_release(local);
+	neo_context_destroy(definer);
+
+	neo_context* reader = neo_context_create();
+	neo_value* global = neo_eval(reader, "shared", &error);
+	check("neo_define over a global keeps the global", global && neo_value_type(global) == NEO_LIST &&
+		neo_list_length(global) == 3 && neo_value_int(neo_list_item(global, 2)) == 3);
+	neo_value_release(global);
+	neo_context_destroy(reader);
+}
+
+//a string literal longer than the chunks in which ./neo -f reads a script.
+static void long_literal(void)
+{
+	const size_t length = 70000;
+	char path[] = "/tmp/neo-testapi-XXXXXX";
+	int fd = mkstemp(path);
+	FILE* script = fd < 0 ? NULL : fdopen(fd, "w");
+	if(script == NULL)
+	{
+		check("long string literal in a script", 0);
+		return;
+	}
+	fputs("s = '", script);
+	for(size_t i = 0; i < length; ++i)
+		fputc('x', script);
+	fputs("y'\ns ? 'y'\n", script);
+	fclose(script);
+
+	char command[64], output[256] = "";
+	snprintf(command, sizeof(command), "./neo -f %s | tail -n 1", path);
+	FILE* out = popen(command, "r");
+	if(out)
+	{
+		if(fgets(output, sizeof(output), out) == NULL)
+			output[0] = '\0';
+		pclose(out);
+	}
+	unlink(path);
+	check("long string literal in a script", atoi(output) == (int) length && strchr(output, '\n'));
+}
+
+//the metrics command gives the same line of JSON in each way of running a script.
+static void metrics_command(void)
+{
+	static const char* modes[] = { "-f", "-j2", "-p" };
+	char path[] = "/tmp/neo-testapi-XXXXXX";
+	int fd = mkstemp(path);
+	FILE* script = fd < 0 ? NULL : fdopen(fd, "w");
+	if(script)
+	{
+		fputs("a = 1\nb = a + 1\nmetrics\nb\n", script);
+		fclose(script);
+	}
+	for(int i = 0; i < 3; ++i)
+	{
+		char name[64], command[64], output[4096] = "", last[16] = "";
+		snprintf(name, sizeof(name), "metrics in a script run with %s", modes[i]);
+		FILE* out = NULL;
+		if(script)
+		{
+			snprintf(command, sizeof(command), "./neo %s %s | tail -n 2", modes[i], path);
+			out = popen(command, "r");
+		}
+		if(out)
+		{
+			if(fgets(output, sizeof(output), out) == NULL || fgets(last, sizeof(last), out) == NULL)
+				output[0] = '\0';
+			pclose(out);
+		}
+		check(name, !strncmp(output, "{\"memory\": ", 11) && strchr(output, '\n') && atoi(last) == 2);
+	}
+	if(script)
+		unlink(path);
+}
+
+int main(void)
+{
+	define_over_global();
+	long_literal();
+	metrics_command();
+	printf("total test cases=%d passed=%d failed=%d\n", cases, passed, cases - passed);
+	return cases == passed ? 0 : 1;
+}